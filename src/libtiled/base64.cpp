@@ -0,0 +1,181 @@
+/*
+ * base64.cpp
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base64.h"
+
+#include <QByteArray>
+#include <QChar>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define TILED_BASE64_SSE2
+#  include <emmintrin.h>
+#endif
+
+using namespace Tiled;
+
+// The value of each ASCII character in the base64 alphabet, or -1
+static const signed char base64Values[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+};
+
+#ifdef TILED_BASE64_SSE2
+
+static inline __m128i loadBlock(const uchar *data)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+/**
+ * Loads 16 UTF-16 characters as bytes. The saturation treats them as signed,
+ * so characters from 256 to 0x7FFF become 255 and those from 0x8000 up
+ * become 0. Neither is part of the alphabet, so they are still rejected.
+ */
+static inline __m128i loadBlock(const ushort *data)
+{
+    const __m128i *p = reinterpret_cast<const __m128i*>(data);
+    return _mm_packus_epi16(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+}
+
+static inline __m128i inRange(__m128i c, char first, char last)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(first - 1)),
+                         _mm_cmplt_epi8(c, _mm_set1_epi8(last + 1)));
+}
+
+/**
+ * Decodes a block of 16 characters into 12 bytes. Returns false without
+ * writing anything when the block contains characters outside of the
+ * alphabet, which are left to the scalar code.
+ */
+static inline bool decodeBlock(__m128i c, char *out)
+{
+    // Characters above 127 are negative and fall outside of every range
+    const __m128i upper = inRange(c, 'A', 'Z');
+    const __m128i lower = inRange(c, 'a', 'z');
+    const __m128i digit = inRange(c, '0', '9');
+    const __m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+
+    const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+                                       _mm_or_si128(_mm_or_si128(digit, plus),
+                                                    slash));
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+        return false;
+
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8('\0' - 'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+    const __m128i sextets = _mm_add_epi8(c, shift);
+
+    // Merge pairs of 6-bit values into 12 bits, then pairs of those into 24
+    const __m128i pairs =
+            _mm_or_si128(_mm_slli_epi16(_mm_and_si128(sextets,
+                                                      _mm_set1_epi16(0xFF)), 6),
+                         _mm_srli_epi16(sextets, 8));
+    const __m128i quads =
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs,
+                                                      _mm_set1_epi32(0xFFFF)), 12),
+                         _mm_srli_epi32(pairs, 16));
+
+    quint32 values[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values), quads);
+
+    for (int i = 0; i < 4; ++i) {
+        out[0] = char(values[i] >> 16);
+        out[1] = char(values[i] >> 8);
+        out[2] = char(values[i]);
+        out += 3;
+    }
+    return true;
+}
+
+#endif // TILED_BASE64_SSE2
+
+template <typename Char>
+static QByteArray decode(const Char *data, int length)
+{
+    QByteArray result(length / 4 * 3 + 3, Qt::Uninitialized);
+    char *out = result.data();
+
+    const Char *in = data;
+    const Char *end = data + length;
+    quint32 buffer = 0;
+    int count = 0;
+
+    while (in != end) {
+#ifdef TILED_BASE64_SSE2
+        // Only whole groups of four characters can be handed to the vector
+        // code, so it is only tried when no characters are pending.
+        if (count == 0) {
+            while (end - in >= 16 && decodeBlock(loadBlock(in), out)) {
+                in += 16;
+                out += 12;
+            }
+            if (in == end)
+                break;
+        }
+#endif
+        const uint c = *in++;
+        const int value = (c < 128) ? base64Values[c] : -1;
+        if (value < 0)
+            continue;
+
+        buffer = (buffer << 6) | value;
+        if (++count == 4) {
+            out[0] = char(buffer >> 16);
+            out[1] = char(buffer >> 8);
+            out[2] = char(buffer);
+            out += 3;
+            buffer = 0;
+            count = 0;
+        }
+    }
+
+    // Unpadded or padded trailing group
+    if (count == 2) {
+        *out++ = char(buffer >> 4);
+    } else if (count == 3) {
+        *out++ = char(buffer >> 10);
+        *out++ = char(buffer >> 2);
+    }
+
+    result.resize(int(out - result.constData()));
+    return result;
+}
+
+QByteArray Tiled::decodeBase64(const QChar *data, int length)
+{
+    return decode(reinterpret_cast<const ushort*>(data), length);
+}
+
+QByteArray Tiled::decodeBase64(const char *data, int length)
+{
+    return decode(reinterpret_cast<const uchar*>(data), length);
+}
@@ -0,0 +1,53 @@
+/*
+ * base64.h
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include "tiled_global.h"
+
+class QByteArray;
+class QChar;
+
+namespace Tiled {
+
+/**
+ * Decodes base64 encoded text. Characters outside of the base64 alphabet,
+ * like whitespace and padding, are skipped, matching the behavior of
+ * QByteArray::fromBase64().
+ *
+ * Unlike QByteArray::fromBase64(), this works directly on UTF-16 text, so
+ * the text of an XML element can be decoded without converting it first.
+ * Runs of valid characters are decoded 16 at a time when SSE2 is available.
+ *
+ * @param data   the base64 encoded text
+ * @param length the number of characters in \a data
+ * @return the decoded data
+ */
+QByteArray TILEDSHARED_EXPORT decodeBase64(const QChar *data, int length);
+
+/**
+ * Overload of decodeBase64() for 8-bit text.
+ */
+QByteArray TILEDSHARED_EXPORT decodeBase64(const char *data, int length);
+
+} // namespace Tiled
+
+#endif // BASE64_H
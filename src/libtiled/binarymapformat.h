@@ -0,0 +1,80 @@
+/*
+ * binarymapformat.h
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINARYMAPFORMAT_H
+#define BINARYMAPFORMAT_H
+
+#include <QDataStream>
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Constants of the binary map format, which is written by
+ * MapWriter::writeBinaryMap() and read by MapReader::readBinaryMap().
+ *
+ * A binary map file starts with a header and ends with a trailer:
+ *
+ *   header:  magic, quint32 version
+ *   trailer: quint64 offset and quint64 size of the description, magic
+ *
+ * In between are the chunks of the tile layers, each holding the global tile
+ * IDs of a rectangle of a layer as 32-bit values, either raw or compressed
+ * with zlib. They are followed by the description of the map, which holds
+ * the map attributes, the tileset table, the layers and their properties.
+ * Each tile layer in the description has an index of its chunks, giving the
+ * rectangle, compression, file offset and size of every chunk, so that
+ * chunks can be found without looking at any of the others.
+ *
+ * All numbers are little-endian. The description is written with a
+ * QDataStream prepared by prepareStream().
+ */
+namespace BinaryMapFormat {
+
+const char Magic[4] = { 'T', 'M', 'X', 'B' };
+
+enum {
+    Version = 1,
+    HeaderSize = 8,
+    TrailerSize = 20
+};
+
+enum LayerType {
+    TileLayerType = 0,
+    ObjectGroupType = 1
+};
+
+enum ChunkCompression {
+    NoCompression = 0,
+    ZlibCompression = 1
+};
+
+inline void prepareStream(QDataStream &stream)
+{
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setVersion(QDataStream::Qt_4_5);
+}
+
+} // namespace BinaryMapFormat
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // BINARYMAPFORMAT_H
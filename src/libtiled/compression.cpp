@@ -102,6 +102,67 @@ QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
     return out;
 }
 
+bool Tiled::decompress(const QByteArray &data, DecompressionSink &sink,
+                       int blockSize)
+{
+    QByteArray block(blockSize, Qt::Uninitialized);
+    z_stream strm;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = (Bytef *) data.data();
+    strm.avail_in = data.length();
+    strm.next_out = (Bytef *) block.data();
+    strm.avail_out = blockSize;
+
+    int ret = inflateInit2(&strm, 15 + 32);
+
+    if (ret != Z_OK) {
+        logZlibError(ret);
+        return false;
+    }
+
+    do {
+        ret = inflate(&strm, Z_NO_FLUSH);
+
+        switch (ret) {
+            case Z_NEED_DICT:
+            case Z_STREAM_ERROR:
+            case Z_BUF_ERROR: // The data ended before the end of the stream
+                ret = Z_DATA_ERROR;
+            case Z_DATA_ERROR:
+            case Z_MEM_ERROR:
+                inflateEnd(&strm);
+                logZlibError(ret);
+                return false;
+        }
+
+        // Hand out the block once it is full or the stream has ended
+        if (strm.avail_out == 0 || ret == Z_STREAM_END) {
+            const int length = blockSize - strm.avail_out;
+            if (length > 0 && !sink.write(block.constData(), length)) {
+                inflateEnd(&strm);
+                return false;
+            }
+
+            strm.next_out = (Bytef *) block.data();
+            strm.avail_out = blockSize;
+        }
+    }
+    while (ret != Z_STREAM_END);
+
+    const bool trailingData = strm.avail_in != 0;
+    inflateEnd(&strm);
+
+    if (trailingData) {
+        logZlibError(Z_DATA_ERROR);
+        return false;
+    }
+
+    return true;
+}
+
 QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
 {
     QByteArray out(1024, Qt::Uninitialized);
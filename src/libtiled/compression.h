@@ -47,6 +47,40 @@ enum CompressionMethod {
 QByteArray TILEDSHARED_EXPORT decompress(const QByteArray &data,
                                          int expectedSize = 1024);
 
+/**
+ * Receives decompressed data block by block.
+ *
+ * \sa decompress(const QByteArray &, DecompressionSink &, int)
+ */
+class TILEDSHARED_EXPORT DecompressionSink
+{
+public:
+    virtual ~DecompressionSink() {}
+
+    /**
+     * Called for each block of decompressed data. Returning false aborts
+     * decompressing.
+     */
+    virtual bool write(const char *data, int length) = 0;
+};
+
+/**
+ * Decompresses either zlib or gzip compressed memory, passing the
+ * uncompressed data to \a sink as it becomes available. Only a single block
+ * is kept in memory, and there is no need to know the uncompressed size in
+ * advance.
+ *
+ * All blocks except for the last one are exactly \a blockSize bytes long.
+ *
+ * @param data      the compressed data
+ * @param sink      the sink receiving the uncompressed data
+ * @param blockSize the size of the blocks passed to the sink in bytes
+ * @return whether decompressing succeeded and the sink accepted all data
+ */
+bool TILEDSHARED_EXPORT decompress(const QByteArray &data,
+                                   DecompressionSink &sink,
+                                   int blockSize = 64 * 1024);
+
 /**
  * Compresses the give data in either gzip or zlib format. Returns a null
  * QByteArray if compression failed.
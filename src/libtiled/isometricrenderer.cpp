@@ -63,11 +63,11 @@ QRectF IsometricRenderer::boundingRect(const MapObject *object) const
 {
     if (object->tile()) {
         const QPointF bottomCenter = tileToPixelCoords(object->position());
-        const QPixmap &img = object->tile()->image();
-        return QRectF(bottomCenter.x() - img.width() / 2,
-                      bottomCenter.y() - img.height(),
-                      img.width(),
-                      img.height()).adjusted(-1, -1, 1, 1);
+        const Tile *tile = object->tile();
+        return QRectF(bottomCenter.x() - tile->width() / 2,
+                      bottomCenter.y() - tile->height(),
+                      tile->width(),
+                      tile->height()).adjusted(-1, -1, 1, 1);
     } else {
         // Take the bounding rect of the projected object, and then add a few
         // pixels on all sides to correct for the line width.
@@ -178,8 +178,11 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
             if (layer->contains(columnItr)) {
                 if (const Tile *tile = layer->tileAt(columnItr)) {
-                    const QPixmap &img = tile->image();
-                    painter->drawPixmap(x, y - img.height(), img);
+                    const QRect &source = tile->atlasRect();
+                    painter->drawPixmap(x, y - source.height(),
+                                        tile->atlas(),
+                                        source.x(), source.y(),
+                                        source.width(), source.height());
                 }
             }
 
@@ -224,18 +227,19 @@ void IsometricRenderer::drawMapObject(QPainter *painter,
     QPen pen(Qt::black);
 
     if (object->tile()) {
-        const QPixmap &img = object->tile()->image();
-        QPointF paintOrigin(-img.width() / 2, -img.height());
+        const Tile *tile = object->tile();
+        QPointF paintOrigin(-tile->width() / 2, -tile->height());
         paintOrigin += tileToPixelCoords(object->position()).toPoint();
-        painter->drawPixmap(paintOrigin, img);
+        painter->drawPixmap(paintOrigin, tile->atlas(),
+                            QRectF(tile->atlasRect()));
 
         pen.setStyle(Qt::SolidLine);
         painter->setPen(pen);
-        painter->drawRect(QRectF(paintOrigin, img.size()));
+        painter->drawRect(QRectF(paintOrigin, tile->size()));
         pen.setStyle(Qt::DotLine);
         pen.setColor(color);
         painter->setPen(pen);
-        painter->drawRect(QRectF(paintOrigin, img.size()));
+        painter->drawRect(QRectF(paintOrigin, tile->size()));
     } else {
         QColor brushColor = color;
         brushColor.setAlpha(50);
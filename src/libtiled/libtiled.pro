@@ -20,7 +20,8 @@ DEFINES += QT_NO_CAST_FROM_ASCII \
 DEFINES += TILED_LIBRARY
 contains(QT_CONFIG, reduce_exports): CONFIG += hide_symbols
 OBJECTS_DIR = .obj
-SOURCES += compression.cpp \
+SOURCES += base64.cpp \
+    compression.cpp \
     isometricrenderer.cpp \
     layer.cpp \
     map.cpp \
@@ -30,9 +31,14 @@ SOURCES += compression.cpp \
     objectgroup.cpp \
     orthogonalrenderer.cpp \
     properties.cpp \
+    regionbuilder.cpp \
+    tilechunk.cpp \
     tilelayer.cpp \
-    tileset.cpp
-HEADERS += compression.h \
+    tileset.cpp \
+    tilesetcache.cpp
+HEADERS += base64.h \
+    binarymapformat.h \
+    compression.h \
     isometricrenderer.h \
     layer.h \
     map.h \
@@ -44,10 +50,13 @@ HEADERS += compression.h \
     objectgroup.h \
     orthogonalrenderer.h \
     properties.h \
+    regionbuilder.h \
     tile.h \
     tiled_global.h \
+    tilechunk.h \
     tilelayer.h \
-    tileset.h
+    tileset.h \
+    tilesetcache.h
 mac {
     contains(QT_CONFIG, ppc):CONFIG += x86 \
         ppc
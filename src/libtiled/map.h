@@ -223,7 +223,8 @@ public:
 
     /**
      * Returns whether the given \a tileset is used by any tile layer of this
-     * map.
+     * map. Takes time linear in the number of layers, since each tile layer
+     * keeps track of the tilesets it references.
      */
     bool isTilesetUsed(Tileset *tileset) const;
 
@@ -22,6 +22,8 @@
 
 #include "mapreader.h"
 
+#include "base64.h"
+#include "binarymapformat.h"
 #include "compression.h"
 #include "objectgroup.h"
 #include "map.h"
@@ -29,13 +31,24 @@
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tilesetcache.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QFutureSynchronizer>
+#include <QImageReader>
 #include <QMap>
+#include <QSharedPointer>
+#include <QVector>
 #include <QXmlStreamReader>
+#include <QtConcurrentRun>
+#include <QtEndian>
+
+#include <climits>
+#include <cstring>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -49,18 +62,37 @@ class MapReaderPrivate
 
 public:
     MapReaderPrivate(MapReader *mapReader):
+        mLazyLoading(false),
+        mDeferredImageLoading(false),
         p(mapReader),
         mMap(0),
+        mGidTableDirty(false),
+        mMappedData(0),
+        mMappedSize(0),
+        mMappedPos(0),
+        mMappedCharacters(0),
+        mMappedBytes(0),
         mReadingExternalTileset(false)
     {}
 
     Map *readMap(QIODevice *device, const QString &path);
+    Map *readMap(const QSharedPointer<QIODevice> &source,
+                 const char *data, qint64 size, const QString &path);
     Tileset *readTileset(QIODevice *device, const QString &path);
+    Map *readBinaryMap(const QSharedPointer<QIODevice> &source,
+                       const char *data, qint64 size, const QString &path);
+
+    static bool isBinaryMap(QIODevice *device);
 
-    bool openFile(QFile *file);
+    bool openFile(QFile *file,
+                  QIODevice::OpenMode mode = QFile::ReadOnly | QFile::Text);
 
     QString errorString() const;
 
+    bool mLazyLoading;
+    bool mDeferredImageLoading;
+    QRect mRegion;
+
 private:
     bool readNextStartElement();
     void readUnknownElement();
@@ -71,13 +103,97 @@ private:
     Tileset *readTileset();
     void readTilesetTile(Tileset *tileset);
     void readTilesetImage(Tileset *tileset);
+    bool loadTilesetImage(Tileset *tileset, const QString &source);
+
+    /**
+     * The encoded data of a tile layer, which is decoded by a worker thread
+     * while the rest of the map is being read, or by the layer itself when
+     * it is loaded on demand. Keeps a copy of the tilesets known at the point
+     * the data was read, to look up the tiles with.
+     */
+    struct LayerData : public TileLayerLoader
+    {
+        /**
+         * A piece of encoded data, filling a rectangle of the layer. Layer
+         * data without chunks is stored as a single chunk covering the
+         * whole layer.
+         *
+         * Base64 and CSV text found in a mapped file is kept as the part of
+         * the mapping in \c encoded, and only decoded along with the tiles.
+         */
+        struct Chunk
+        {
+            QRect rect;
+            bool csv;
+            QByteArray data;
+            QByteArray encoded;
+            QString text;
+            QString compression;
+            qint64 lineNumber;
+            qint64 columnNumber;
+        };
+
+        LayerData(TileLayer *tileLayer):
+            tileLayer(tileLayer),
+            lineNumber(0),
+            columnNumber(0)
+        {}
+
+        Tile *tileForGid(int gid, bool &ok) const;
+        QString errorString() const;
+
+        /**
+         * Returns whether the given rectangle of the layer overlaps the
+         * region that is being read.
+         */
+        bool overlapsRegion(const QRect &rect) const
+        { return region.isNull() || region.intersects(rect); }
+
+        bool isInRegion(int x, int y) const
+        { return region.isNull() || region.contains(x, y); }
+
+        QRect area() const;
+        QSize maxTileSize() const;
+        QSet<Tileset*> tilesets() const;
+        bool load(TileLayer *layer, QString *error);
+        TileLayerLoader *clone() const { return new LayerData(*this); }
+
+        TileLayer *tileLayer;
+        QRect region;           // Part of the layer to place tiles in
+        QList<Chunk> chunks;
+        QVector<Tile*> gidTable;
+        QMap<int, Tileset*> gidsToTileset;
+        QSharedPointer<QIODevice> source;   // Holds the data chunks refer to
+        QString error;
+        qint64 lineNumber;      // Position of the chunk that failed
+        qint64 columnNumber;
+    };
 
     TileLayer *readLayer();
-    void readLayerData(TileLayer *tileLayer);
-    void decodeBinaryLayerData(TileLayer *tileLayer,
-                               const QString &text,
-                               const QStringRef &compression);
-    void decodeCSVLayerData(TileLayer *tileLayer, const QString &text);
+    void readLayerData(LayerData *layerData);
+    void readLayerDataContents(LayerData *layerData,
+                               const QStringRef &encoding,
+                               const QStringRef &compression,
+                               const QRect &rect, bool allowChunks);
+
+    qint64 mappedOffset(qint64 characterOffset);
+    QByteArray mappedText(const QString &elementName);
+
+    LayerData *createLayerData(TileLayer *tileLayer) const;
+    void queueLayerData(LayerData *layerData);
+    bool finishLayerData();
+
+    class TileDataDecoder;
+
+    static void decodeLayerData(LayerData *layerData);
+    static void decodeChunk(LayerData *layerData, LayerData::Chunk &chunk);
+    static void decodeBinaryLayerData(LayerData *layerData,
+                                      const LayerData::Chunk &chunk);
+    static void decodeCSVLayerData(LayerData *layerData,
+                                   const LayerData::Chunk &chunk);
+    template <typename Char>
+    static void decodeCSVText(LayerData *layerData, const QRect &rect,
+                              const Char *pos, const Char *end);
 
     /**
      * Returns the tile for the given global tile ID. When an error occurs,
@@ -90,18 +206,62 @@ private:
      */
     Tile *tileForGid(int gid, bool &ok);
 
+    /**
+     * Fast version of tileForGid(), which looks the tile up in the GID table.
+     * Only global tile IDs outside of the table go through tileForGid().
+     */
+    Tile *lookupTile(int gid, bool &ok)
+    {
+        if (uint(gid) < uint(mGidTable.size())) {
+            ok = true;
+            return mGidTable.at(gid);
+        }
+        return tileForGid(gid, ok);
+    }
+
+    void updateGidTable();
+
     ObjectGroup *readObjectGroup();
     MapObject *readObject();
+    void addObject(ObjectGroup *objectGroup, MapObject *object);
 
     Properties readProperties();
     void readProperty(Properties *properties);
 
+    Map *readBinaryMap(const char *data, qint64 size);
+    Tileset *readBinaryTileset(QDataStream &in);
+    TileLayer *readBinaryTileLayer(QDataStream &in, const char *data,
+                                   qint64 chunkDataEnd);
+    ObjectGroup *readBinaryObjectGroup(QDataStream &in);
+
     MapReader *p;
 
     QString mError;
     QString mPath;
     Map *mMap;
     QMap<int, Tileset*> mGidsToTileset;
+
+    /**
+     * Maps global tile IDs directly to tiles, with entry 0 being the empty
+     * tile. Rebuilt by updateGidTable() after tilesets have been added.
+     */
+    QVector<Tile*> mGidTable;
+    bool mGidTableDirty;
+
+    QList<LayerData*> mLayerData;
+    QFutureSynchronizer<void> mDecoding;
+    /**
+     * The file being read, which keeps the data alive that chunks refer to,
+     * along with its mapping. Layer data in mapped TMX files is searched
+     * from the current position onwards.
+     */
+    QSharedPointer<QIODevice> mSource;
+    const char *mMappedData;
+    qint64 mMappedSize;
+    qint64 mMappedPos;
+    qint64 mMappedCharacters;   // Position last looked up by mappedOffset()
+    qint64 mMappedBytes;
+
     bool mReadingExternalTileset;
 
     QXmlStreamReader xml;
@@ -125,6 +285,39 @@ Map *MapReaderPrivate::readMap(QIODevice *device, const QString &path)
     }
 
     mGidsToTileset.clear();
+    mGidTable.clear();
+    mGidTableDirty = false;
+    return map;
+}
+
+/**
+ * Reads a TMX map from \a data, which is the mapping of the file \a source.
+ * The XML reader pulls from the mapping through a buffer, while the layer
+ * data is taken straight from the mapping.
+ */
+Map *MapReaderPrivate::readMap(const QSharedPointer<QIODevice> &source,
+                               const char *data, qint64 size,
+                               const QString &path)
+{
+    Q_ASSERT(size <= INT_MAX);
+
+    QBuffer buffer;
+    buffer.setData(QByteArray::fromRawData(data, int(size)));
+    buffer.open(QIODevice::ReadOnly);
+
+    mSource = source;
+    mMappedData = data;
+    mMappedSize = size;
+    mMappedPos = 0;
+    mMappedCharacters = 0;
+    mMappedBytes = 0;
+
+    Map *map = readMap(&buffer, path);
+
+    mSource.clear();
+    mMappedData = 0;
+    mMappedSize = 0;
+    mMappedPos = 0;
     return map;
 }
 
@@ -146,6 +339,38 @@ Tileset *MapReaderPrivate::readTileset(QIODevice *device, const QString &path)
     return tileset;
 }
 
+/**
+ * Reads a binary map from \a data, which is kept valid by \a source for as
+ * long as any of the layers refer to it.
+ */
+Map *MapReaderPrivate::readBinaryMap(const QSharedPointer<QIODevice> &source,
+                                     const char *data, qint64 size,
+                                     const QString &path)
+{
+    mError.clear();
+    mPath = path;
+    mSource = source;
+
+    Map *map = readBinaryMap(data, size);
+
+    mSource.clear();
+    mGidsToTileset.clear();
+    mGidTable.clear();
+    mGidTableDirty = false;
+    return map;
+}
+
+/**
+ * Returns whether the data available on \a device starts like a binary map.
+ */
+bool MapReaderPrivate::isBinaryMap(QIODevice *device)
+{
+    const QByteArray magic = device->peek(sizeof(BinaryMapFormat::Magic));
+    return magic.size() == int(sizeof(BinaryMapFormat::Magic))
+            && memcmp(magic.constData(), BinaryMapFormat::Magic,
+                      sizeof(BinaryMapFormat::Magic)) == 0;
+}
+
 QString MapReaderPrivate::errorString() const
 {
     if (!mError.isEmpty()) {
@@ -158,12 +383,12 @@ QString MapReaderPrivate::errorString() const
     }
 }
 
-bool MapReaderPrivate::openFile(QFile *file)
+bool MapReaderPrivate::openFile(QFile *file, QIODevice::OpenMode mode)
 {
     if (!file->exists()) {
         mError = tr("File not found: %1").arg(file->fileName());
         return false;
-    } else if (!file->open(QFile::ReadOnly | QFile::Text)) {
+    } else if (!file->open(mode)) {
         mError = tr("Unable to read file: %1").arg(file->fileName());
         return false;
     }
@@ -231,21 +456,30 @@ Map *MapReaderPrivate::readMap()
 
     mMap = new Map(orientation, QRect(0, 0, mapWidth, mapHeight), tileWidth, tileHeight);
 
+    // The layers are only added to the map once the tile layers have been
+    // decoded, since adding a layer looks at its tiles.
+    QList<Layer*> layers;
+
     while (readNextStartElement()) {
         if (xml.name() == "properties")
             mMap->mergeProperties(readProperties());
         else if (xml.name() == "tileset")
             mMap->addTileset(readTileset());
         else if (xml.name() == "layer")
-            mMap->addLayer(readLayer());
+            layers.append(readLayer());
         else if (xml.name() == "objectgroup")
-            mMap->addLayer(readObjectGroup());
+            layers.append(readObjectGroup());
         else
             readUnknownElement();
     }
 
+    const bool layerDataOk = finishLayerData();
+
+    foreach (Layer *layer, layers)
+        mMap->addLayer(layer);
+
     // Clean up in case of error
-    if (xml.hasError()) {
+    if (xml.hasError() || !layerDataOk) {
         delete mMap;
         mMap = 0;
 
@@ -309,8 +543,10 @@ Tileset *MapReaderPrivate::readTileset()
         skipCurrentElement();
     }
 
-    if (tileset && !mReadingExternalTileset)
+    if (tileset && !mReadingExternalTileset) {
         mGidsToTileset.insert(firstGid, tileset);
+        mGidTableDirty = true;
+    }
 
     return tileset;
 }
@@ -355,13 +591,31 @@ void MapReaderPrivate::readTilesetImage(Tileset *tileset)
 
     source = p->resolveReference(source, mPath);
 
-    const QImage tilesetImage = p->readExternalImage(source);
-    if (!tileset->loadFromImage(tilesetImage, source))
+    if (!loadTilesetImage(tileset, source))
         xml.raiseError(tr("Error loading tileset image:\n'%1'").arg(source));
 
     skipCurrentElement();
 }
 
+/**
+ * Loads the tileset image \a source into \a tileset. When image loading is
+ * deferred, only the size of the image is read and the tileset gets
+ * placeholder tiles.
+ */
+bool MapReaderPrivate::loadTilesetImage(Tileset *tileset,
+                                        const QString &source)
+{
+    if (mDeferredImageLoading) {
+        // Most image formats tell their size without decoding the image
+        const QSize size = QImageReader(source).size();
+        if (size.isValid())
+            return tileset->loadPlaceholder(size, source);
+    }
+
+    const QImage tilesetImage = p->readExternalImage(source);
+    return tileset->loadFromImage(tilesetImage, source);
+}
+
 static void readLayerAttributes(Layer *layer,
                                 const QXmlStreamAttributes &atts)
 {
@@ -391,20 +645,30 @@ TileLayer *MapReaderPrivate::readLayer()
 
     TileLayer *tileLayer = new TileLayer(name, x, y, QRect(0, 0, width, height));
     readLayerAttributes(tileLayer, atts);
+    updateGidTable();
+
+    LayerData *layerData = createLayerData(tileLayer);
 
     while (readNextStartElement()) {
         if (xml.name() == "properties")
             tileLayer->mergeProperties(readProperties());
         else if (xml.name() == "data")
-            readLayerData(tileLayer);
+            readLayerData(layerData);
         else
             readUnknownElement();
     }
 
+    // Only hand off the encoded data once the whole layer has been read,
+    // since tiles given as <tile> elements are placed while reading
+    if (layerData->chunks.isEmpty())
+        delete layerData;
+    else
+        queueLayerData(layerData);
+
     return tileLayer;
 }
 
-void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
+void MapReaderPrivate::readLayerData(LayerData *layerData)
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == "data");
 
@@ -412,15 +676,35 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
     QStringRef encoding = atts.value(QLatin1String("encoding"));
     QStringRef compression = atts.value(QLatin1String("compression"));
 
-    int x = 0;
-    int y = 0;
+    const TileLayer *tileLayer = layerData->tileLayer;
+    const QRect rect(0, 0, tileLayer->width(), tileLayer->height());
+
+    readLayerDataContents(layerData, encoding, compression, rect, true);
+}
+
+/**
+ * Reads the contents of a <data> or <chunk> element, which fill \a rect of
+ * the layer. Tiles given as <tile> elements are placed right away, while
+ * encoded data is added to \a layerData as a chunk.
+ */
+void MapReaderPrivate::readLayerDataContents(LayerData *layerData,
+                                             const QStringRef &encoding,
+                                             const QStringRef &compression,
+                                             const QRect &rect,
+                                             bool allowChunks)
+{
+    TileLayer *tileLayer = layerData->tileLayer;
+    int x = rect.x();
+    int y = rect.y();
+
+    const QString elementName = xml.name().toString();
 
     while (xml.readNext() != QXmlStreamReader::Invalid) {
         if (xml.isEndElement())
             break;
         else if (xml.isStartElement()) {
             if (xml.name() == QLatin1String("tile")) {
-                if (y >= tileLayer->height()) {
+                if (y > rect.bottom()) {
                     xml.raiseError(tr("Too many <tile> elements"));
                     continue;
                 }
@@ -428,119 +712,646 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
                 const QXmlStreamAttributes atts = xml.attributes();
                 int gid = atts.value(QLatin1String("gid")).toString().toInt();
                 bool ok;
-                Tile *tile = tileForGid(gid, ok);
-                if (ok)
-                    tileLayer->setTile(x, y, tile);
-                else
+                Tile *tile = lookupTile(gid, ok);
+                if (!ok)
                     xml.raiseError(tr("Invalid tile: %1").arg(gid));
+                else if (layerData->isInRegion(x, y))
+                    tileLayer->setTile(x, y, tile);
 
                 x++;
-                if (x >= tileLayer->width()) {
-                    x = 0;
+                if (x > rect.right()) {
+                    x = rect.x();
                     y++;
                 }
 
                 skipCurrentElement();
+            } else if (allowChunks && xml.name() == QLatin1String("chunk")) {
+                const QXmlStreamAttributes atts = xml.attributes();
+                const QRect chunkRect(
+                        atts.value(QLatin1String("x")).toString().toInt(),
+                        atts.value(QLatin1String("y")).toString().toInt(),
+                        atts.value(QLatin1String("width")).toString().toInt(),
+                        atts.value(QLatin1String("height")).toString().toInt());
+
+                if (layerData->overlapsRegion(chunkRect)) {
+                    readLayerDataContents(layerData, encoding, compression,
+                                          chunkRect, false);
+                } else {
+                    skipCurrentElement();
+                }
             } else {
                 readUnknownElement();
             }
         } else if (xml.isCharacters() && !xml.isWhitespace()) {
+            if (!layerData->overlapsRegion(rect))
+                continue;
+
+            LayerData::Chunk chunk;
+            chunk.rect = rect;
+            chunk.csv = false;
+            chunk.lineNumber = xml.lineNumber();
+            chunk.columnNumber = xml.columnNumber();
+
             if (encoding == QLatin1String("base64")) {
-                decodeBinaryLayerData(tileLayer,
-                                      xml.text().toString(),
-                                      compression);
+                chunk.compression = compression.toString();
+                chunk.encoded = mappedText(elementName);
+
+                // Decodes straight from the text buffer of the XML reader
+                // when the text can't be taken from the mapped file
+                if (chunk.encoded.isNull()) {
+                    const QStringRef text = xml.text();
+                    chunk.data = decodeBase64(text.unicode(), text.size());
+                }
             } else if (encoding == QLatin1String("csv")) {
-                decodeCSVLayerData(tileLayer, xml.text().toString());
+                chunk.csv = true;
+                chunk.encoded = mappedText(elementName);
+                if (chunk.encoded.isNull())
+                    chunk.text = xml.text().toString();
             } else {
                 xml.raiseError(tr("Unknown encoding: %1")
                                .arg(encoding.toString()));
                 continue;
             }
+
+            layerData->chunks.append(chunk);
         }
     }
 }
 
-void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
-                                      const QString &text,
-                                      const QStringRef &compression)
+static inline bool isSpace(ushort c)
 {
-    QByteArray tileData = QByteArray::fromBase64(text.toLatin1());
-    const int size = (tileLayer->width() * tileLayer->height()) * 4;
-  
-    if (compression == QLatin1String("zlib")
-        || compression == QLatin1String("gzip")) {
-        tileData = decompress(tileData, size);
-    } else if (!compression.isEmpty()) {
-        xml.raiseError(tr("Compression method '%1' not supported")
-                       .arg(compression.toString()));
-        return;
+    if (c < 128)
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    return QChar(c).isSpace();
+}
+
+/**
+ * Returns the byte offset in the mapped file of the given character offset of
+ * the XML reader, assuming the file is UTF-8 encoded. Offsets are expected
+ * to be asked for in increasing order.
+ */
+qint64 MapReaderPrivate::mappedOffset(qint64 characterOffset)
+{
+    if (characterOffset < mMappedCharacters) {
+        mMappedCharacters = 0;
+        mMappedBytes = 0;
+    }
+
+    // The byte order mark is not reported as a character
+    if (mMappedBytes == 0 && mMappedSize >= 3
+        && memcmp(mMappedData, "\xef\xbb\xbf", 3) == 0)
+        mMappedBytes = 3;
+
+    while (mMappedCharacters < characterOffset && mMappedBytes < mMappedSize) {
+        const uchar c = mMappedData[mMappedBytes++];
+        if ((c & 0xc0) != 0x80)
+            mMappedCharacters += (c >= 0xf0) ? 2 : 1;  // Surrogate pairs
+    }
+
+    return mMappedBytes;
+}
+
+/**
+ * Returns the text that the XML reader just reported for the element
+ * \a elementName as a part of the mapped file. Returns a null byte array when
+ * not reading from a mapping, or when the text in the file may differ from
+ * the reported text, as it does when it contains references or isn't plain
+ * ASCII.
+ *
+ * The element is searched in the file from where the previous one was found.
+ * The position of the XML reader tells whether the right one was found, since
+ * elements that were skipped may come first.
+ */
+QByteArray MapReaderPrivate::mappedText(const QString &elementName)
+{
+    if (!mMappedData)
+        return QByteArray();
+
+    // The XML reader may have looked ahead a little
+    static const qint64 Tolerance = 32;
+    const qint64 expectedEnd = mappedOffset(xml.characterOffset());
+
+    const QByteArray tag = '<' + elementName.toLatin1();
+    const char *mappedEnd = mMappedData + mMappedSize;
+    const char *pos = mMappedData + mMappedPos;
+
+    while ((pos = static_cast<const char*>(
+                memchr(pos, '<', mappedEnd - pos)))) {
+        const char *next = pos + tag.size();
+        if (next >= mappedEnd
+            || memcmp(pos, tag.constData(), tag.size()) != 0
+            || !(*next == '>' || *next == '/' || isSpace(uchar(*next)))) {
+            ++pos;
+            continue;
+        }
+
+        // Find the end of the start tag, skipping attribute values
+        char quote = 0;
+        for (; next < mappedEnd; ++next) {
+            if (quote) {
+                if (*next == quote)
+                    quote = 0;
+            } else if (*next == '"' || *next == '\'') {
+                quote = *next;
+            } else if (*next == '>') {
+                break;
+            }
+        }
+        if (next == mappedEnd)
+            return QByteArray();
+
+        const char *begin = next + 1;
+        const char *end = static_cast<const char*>(
+                    memchr(begin, '<', mappedEnd - begin));
+        if (!end)
+            return QByteArray();
+
+        const qint64 endOffset = end - mMappedData;
+        if (endOffset < expectedEnd - Tolerance) {
+            mMappedPos = endOffset;
+            pos = end;
+            continue;
+        }
+        if (endOffset > expectedEnd + Tolerance || end - begin > INT_MAX)
+            return QByteArray();
+
+        // Line breaks are reported as a single newline
+        qint64 length = end - begin;
+        for (const char *c = begin; c != end; ++c) {
+            if (*c == '&' || uchar(*c) >= 0x80)
+                return QByteArray();
+            if (*c == '\r' && c + 1 != end && c[1] == '\n')
+                --length;
+        }
+        if (length != xml.text().size())
+            return QByteArray();
+
+        mMappedPos = endOffset;
+        return QByteArray::fromRawData(begin, int(end - begin));
     }
 
-    if (size != tileData.length()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
+    return QByteArray();
+}
+
+/**
+ * Creates the layer data for \a tileLayer, which is restricted to the region
+ * that is being read.
+ */
+MapReaderPrivate::LayerData *MapReaderPrivate::createLayerData(
+        TileLayer *tileLayer) const
+{
+    LayerData *layerData = new LayerData(tileLayer);
+    layerData->source = mSource;
+    if (!mRegion.isNull())
+        layerData->region = mRegion.translated(-tileLayer->x(),
+                                               -tileLayer->y());
+    return layerData;
+}
+
+/**
+ * Hands the given layer data to a worker thread for decoding. The layer
+ * must not be touched until finishLayerData() has been called.
+ *
+ * When lazy loading is enabled, the layer data is set as the loader of its
+ * layer instead.
+ */
+void MapReaderPrivate::queueLayerData(LayerData *layerData)
+{
+    layerData->gidTable = mGidTable;
+    layerData->gidsToTileset = mGidsToTileset;
+
+    if (mLazyLoading) {
+        layerData->tileLayer->setLoader(layerData);
         return;
     }
 
-    const unsigned char *data =
-            reinterpret_cast<const unsigned char*>(tileData.constData());
-    int x = 0;
-    int y = 0;
+    mLayerData.append(layerData);
+    mDecoding.addFuture(QtConcurrent::run(&MapReaderPrivate::decodeLayerData,
+                                          layerData));
+}
 
-    for (int i = 0; i < size - 3; i += 4) {
-        const int gid = data[i] |
-                        data[i + 1] << 8 |
-                        data[i + 2] << 16 |
-                        data[i + 3] << 24;
+/**
+ * Waits for all queued layer data to be decoded. When decoding failed for
+ * any of the layers, the error of the first one in the document is set and
+ * false is returned.
+ */
+bool MapReaderPrivate::finishLayerData()
+{
+    mDecoding.waitForFinished();
+    mDecoding.clearFutures();
+
+    bool ok = true;
+    foreach (const LayerData *layerData, mLayerData) {
+        if (!layerData->error.isEmpty()) {
+            mError = layerData->errorString();
+            ok = false;
+            break;
+        }
+    }
 
-        bool ok;
-        Tile *tile = tileForGid(gid, ok);
-        if (ok)
-            tileLayer->setTile(x, y, tile);
-        else {
-            xml.raiseError(tr("Invalid tile: %1").arg(gid));
-            return;
+    qDeleteAll(mLayerData);
+    mLayerData.clear();
+    return ok;
+}
+
+void MapReaderPrivate::decodeLayerData(LayerData *layerData)
+{
+    for (int i = 0; i < layerData->chunks.size(); ++i) {
+        LayerData::Chunk &chunk = layerData->chunks[i];
+
+        decodeChunk(layerData, chunk);
+
+        // Release the encoded data as soon as possible
+        chunk.data.clear();
+        chunk.encoded.clear();
+        chunk.text.clear();
+
+        if (!layerData->error.isEmpty()) {
+            layerData->lineNumber = chunk.lineNumber;
+            layerData->columnNumber = chunk.columnNumber;
+            break;
+        }
+    }
+}
+
+void MapReaderPrivate::decodeChunk(LayerData *layerData,
+                                   LayerData::Chunk &chunk)
+{
+    if (chunk.csv) {
+        decodeCSVLayerData(layerData, chunk);
+    } else {
+        if (!chunk.encoded.isNull())
+            chunk.data = decodeBase64(chunk.encoded.constData(),
+                                      chunk.encoded.size());
+        decodeBinaryLayerData(layerData, chunk);
+    }
+}
+
+/**
+ * Places the tiles within a rectangle of a layer from binary layer data,
+ * which is a list of little-endian 32-bit global tile IDs. The data can be
+ * written in blocks of any multiple of 4 bytes, as they come out of the
+ * decompressor.
+ *
+ * Only the tiles in the region of the layer data are placed. Once the last
+ * row of the region has been seen, any further data is refused.
+ */
+class MapReaderPrivate::TileDataDecoder : public DecompressionSink
+{
+public:
+    TileDataDecoder(LayerData *layerData, const QRect &rect):
+        mLayerData(layerData),
+        mRect(rect),
+        mRegion(layerData->region.isNull() ? rect
+                                           : rect & layerData->region),
+        mX(rect.x()),
+        mY(rect.y()),
+        mExpected(qint64(rect.width()) * rect.height() * 4),
+        mReceived(0),
+        mStopped(false)
+    {}
+
+    bool write(const char *data, int length);
+
+    /**
+     * Skips the rows above the region, which is only possible when the data
+     * is not compressed. Returns the number of bytes skipped.
+     */
+    qint64 skipToRegion();
+
+    /**
+     * Returns the total amount of data expected in bytes.
+     */
+    qint64 expectedSize() const { return mExpected; }
+
+    /**
+     * Returns whether exactly the expected amount of data was written.
+     */
+    bool isComplete() const { return mReceived == mExpected; }
+
+    /**
+     * Returns whether the data past the last row of the region was refused.
+     */
+    bool isStopped() const { return mStopped; }
+
+private:
+    LayerData *mLayerData;
+    const QRect mRect;
+    const QRect mRegion;
+    int mX;
+    int mY;
+    const qint64 mExpected;
+    qint64 mReceived;
+    bool mStopped;
+};
+
+bool MapReaderPrivate::TileDataDecoder::write(const char *data, int length)
+{
+    mReceived += length;
+    if (mReceived > mExpected)
+        return false;
+
+    const unsigned char *bytes =
+            reinterpret_cast<const unsigned char*>(data);
+
+    for (int i = 0; i < length - 3; i += 4) {
+        if (mY > mRegion.bottom()) {
+            mStopped = true;
+            return false;
+        }
+
+        if (mRegion.contains(mX, mY)) {
+            const int gid = bytes[i] |
+                            bytes[i + 1] << 8 |
+                            bytes[i + 2] << 16 |
+                            bytes[i + 3] << 24;
+
+            bool ok;
+            Tile *tile = mLayerData->tileForGid(gid, ok);
+            if (ok)
+                mLayerData->tileLayer->setTile(mX, mY, tile);
+            else {
+                mLayerData->error = tr("Invalid tile: %1").arg(gid);
+                return false;
+            }
         }
 
-        x++;
-        if (x == tileLayer->width()) {
-            x = 0;
-            y++;
+        mX++;
+        if (mX > mRect.right()) {
+            mX = mRect.x();
+            mY++;
         }
     }
+
+    return true;
 }
 
-void MapReaderPrivate::decodeCSVLayerData(TileLayer *tileLayer, const QString &text)
+qint64 MapReaderPrivate::TileDataDecoder::skipToRegion()
 {
-    QString trimText = text.trimmed();
-    QStringList tiles = trimText.split(QLatin1Char(','));
+    Q_ASSERT(mReceived == 0);
 
-    if (tiles.length() != tileLayer->width() * tileLayer->height()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
+    const int rows = qMax(0, mRegion.top() - mRect.top());
+    mY += rows;
+    mReceived = qint64(rows) * mRect.width() * 4;
+    return mReceived;
+}
+
+void MapReaderPrivate::decodeBinaryLayerData(LayerData *layerData,
+                                             const LayerData::Chunk &chunk)
+{
+    const QString &compression = chunk.compression;
+    const QByteArray &tileData = chunk.data;
+    TileDataDecoder decoder(layerData, chunk.rect);
+    bool ok;
+
+    // Compressed data is decoded as it is being inflated, so the
+    // uncompressed layer data is never held in memory as a whole
+    if (compression == QLatin1String("zlib")
+        || compression == QLatin1String("gzip")) {
+        ok = decompress(tileData, decoder);
+    } else if (!compression.isEmpty()) {
+        layerData->error = tr("Compression method '%1' not supported")
+                .arg(compression);
         return;
+    } else if (tileData.length() != decoder.expectedSize()) {
+        ok = false;
+    } else {
+        // Uncompressed data is only looked at from the region onwards
+        const qint64 skipped = decoder.skipToRegion();
+        ok = decoder.write(tileData.constData() + skipped,
+                           tileData.length() - int(skipped));
     }
 
-    for (int y = 0; y < tileLayer->height(); y++) {
-        for (int x = 0; x < tileLayer->width(); x++) {
-            bool conversionOk;
-            const int gid = tiles.at(y * tileLayer->width() + x)
-                            .toInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
+    if ((!ok || !decoder.isComplete()) && !decoder.isStopped()
+        && layerData->error.isEmpty()) {
+        layerData->error = tr("Corrupt layer data for layer '%1'")
+                .arg(layerData->tileLayer->name());
+    }
+}
+
+/**
+ * Parses a decimal number at \a pos, accepting the same input as
+ * QString::toInt() including surrounding whitespace. Stops at the first
+ * character that can't be part of the number, which is left at \a pos.
+ * Returns whether a number was found that fits in an int.
+ */
+template <typename Char>
+static bool parseInt(const Char *&pos, const Char *end, int &value)
+{
+    while (pos != end && isSpace(*pos))
+        ++pos;
+
+    bool negative = false;
+    if (pos != end && (*pos == '-' || *pos == '+')) {
+        negative = (*pos == '-');
+        ++pos;
+    }
+
+    const Char *digits = pos;
+    qint64 result = 0;
+    while (pos != end && *pos >= '0' && *pos <= '9') {
+        result = result * 10 + (*pos - '0');
+        if (result > qint64(INT_MAX) + 1)
+            return false;
+        ++pos;
+    }
+    if (pos == digits)
+        return false;
+
+    if (negative)
+        result = -result;
+    if (result > INT_MAX)
+        return false;
+
+    while (pos != end && isSpace(*pos))
+        ++pos;
+
+    value = int(result);
+    return true;
+}
+
+void MapReaderPrivate::decodeCSVLayerData(LayerData *layerData,
+                                          const LayerData::Chunk &chunk)
+{
+    if (!chunk.encoded.isNull()) {
+        const uchar *data =
+                reinterpret_cast<const uchar*>(chunk.encoded.constData());
+        decodeCSVText(layerData, chunk.rect,
+                      data, data + chunk.encoded.size());
+    } else {
+        const ushort *text =
+                reinterpret_cast<const ushort*>(chunk.text.unicode());
+        decodeCSVText(layerData, chunk.rect,
+                      text, text + chunk.text.length());
+    }
+}
+
+/**
+ * Decodes comma separated layer data in a single pass over the text, without
+ * splitting it up into separate strings first. The text past the last row of
+ * the region is not looked at.
+ */
+template <typename Char>
+void MapReaderPrivate::decodeCSVText(LayerData *layerData, const QRect &rect,
+                                     const Char *pos, const Char *end)
+{
+    TileLayer *tileLayer = layerData->tileLayer;
+
+    int bottom = rect.bottom();
+    if (!layerData->region.isNull())
+        bottom = qMin(bottom, layerData->region.bottom());
+
+    for (int y = rect.top(); y <= bottom; y++) {
+        for (int x = rect.left(); x <= rect.right(); x++) {
+            // Each value after the first one follows a comma
+            if (x > rect.left() || y > rect.top()) {
+                if (pos == end) {
+                    layerData->error = tr("Corrupt layer data for layer '%1'")
+                            .arg(tileLayer->name());
+                    return;
+                }
+                ++pos;
+            }
+
+            int gid;
+            if (!parseInt(pos, end, gid)
+                || (pos != end && *pos != ',')) {
+                layerData->error =
                         tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer->name()));
+                               .arg(x + 1).arg(y + 1).arg(tileLayer->name());
                 return;
             }
+            if (!layerData->isInRegion(x, y))
+                continue;
+
             bool gidOk;
-            Tile *tile = tileForGid(gid, gidOk);
+            Tile *tile = layerData->tileForGid(gid, gidOk);
             if (gidOk)
                 tileLayer->setTile(x, y, tile);
             else {
-                xml.raiseError(tr("Invalid tile: %1").arg(gid));
+                layerData->error = tr("Invalid tile: %1").arg(gid);
+                return;
             }
         }
     }
+
+    // Any remaining values don't fit on the layer
+    if (bottom == rect.bottom() && pos != end) {
+        layerData->error = tr("Corrupt layer data for layer '%1'")
+                .arg(tileLayer->name());
+    }
+}
+
+/**
+ * Returns the tile for the given global tile ID, which must be larger than 0,
+ * or 0 when no tileset contains it. The map of tilesets must not be empty.
+ */
+static Tile *findTile(const QMap<int, Tileset*> &gidsToTileset, int gid)
+{
+    // Navigate one tileset back since upper bound finds the next
+    QMap<int, Tileset*>::const_iterator i = gidsToTileset.upperBound(gid);
+    if (i == gidsToTileset.constBegin())
+        return 0;
+    --i;
+
+    const Tileset *tileset = i.value();
+    return tileset ? tileset->tileAt(gid - i.key()) : 0;
+}
+
+/**
+ * Like MapReaderPrivate::tileForGid(), but safe to use from a worker thread
+ * since it doesn't raise an error.
+ */
+Tile *MapReaderPrivate::LayerData::tileForGid(int gid, bool &ok) const
+{
+    if (uint(gid) < uint(gidTable.size())) {
+        ok = true;
+        return gidTable.at(gid);
+    }
+
+    ok = (gid == 0) || (gid > 0 && !gidsToTileset.isEmpty());
+    return (ok && gid > 0) ? findTile(gidsToTileset, gid) : 0;
+}
+
+/**
+ * Returns the error that occurred while decoding, along with the position of
+ * the chunk that failed. Layer data from binary maps has no position in a
+ * document.
+ */
+QString MapReaderPrivate::LayerData::errorString() const
+{
+    if (lineNumber > 0) {
+        return tr("%3\n\nLine %1, column %2")
+                .arg(lineNumber)
+                .arg(columnNumber)
+                .arg(error);
+    }
+    return error;
+}
+
+/**
+ * Since the tiles are not known before decoding, returns the area covered by
+ * the chunks. Tiles are never placed past the right or bottom edge of the
+ * size the layer was given, so the chunks are cut off there, but chunks in
+ * negative coordinates are taken as a whole.
+ */
+QRect MapReaderPrivate::LayerData::area() const
+{
+    const QRect size = tileLayer->bounds().translated(-tileLayer->x(),
+                                                      -tileLayer->y());
+
+    QRect area;
+    foreach (const Chunk &chunk, chunks) {
+        QRect rect = region.isNull() ? chunk.rect : chunk.rect & region;
+        rect.setRight(qMin(rect.right(), size.right()));
+        rect.setBottom(qMin(rect.bottom(), size.bottom()));
+        if (!rect.isEmpty())
+            area = area.united(rect);
+    }
+    return area;
+}
+
+/**
+ * Since the tiles are not known before decoding, returns all the tilesets
+ * that the layer data could refer to.
+ */
+QSet<Tileset*> MapReaderPrivate::LayerData::tilesets() const
+{
+    return gidsToTileset.values().toSet();
+}
+
+/**
+ * Since the tiles are not known before decoding, returns the size of the
+ * largest tile that the layer data could refer to.
+ */
+QSize MapReaderPrivate::LayerData::maxTileSize() const
+{
+    QSize size(0, 0);
+    QMap<int, Tileset*>::const_iterator it = gidsToTileset.constBegin();
+    QMap<int, Tileset*>::const_iterator it_end = gidsToTileset.constEnd();
+    for (; it != it_end; ++it) {
+        const Tileset *tileset = it.value();
+        for (int i = 0; i < tileset->tileCount(); ++i) {
+            const Tile *tile = tileset->tileAt(i);
+            size = size.expandedTo(QSize(tile->width(), tile->height()));
+        }
+    }
+    return size;
+}
+
+bool MapReaderPrivate::LayerData::load(TileLayer *layer, QString *error)
+{
+    // Layer data may have been cloned along with its layer
+    tileLayer = layer;
+
+    decodeLayerData(this);
+    source.clear();
+
+    if (!this->error.isEmpty()) {
+        *error = errorString();
+        return false;
+    }
+    return true;
 }
 
 Tile *MapReaderPrivate::tileForGid(int gid, bool &ok)
@@ -557,19 +1368,60 @@ Tile *MapReaderPrivate::tileForGid(int gid, bool &ok)
         xml.raiseError(tr("Tile used but no tilesets specified"));
         ok = false;
     } else {
-        // Find the tileset containing this tile
-        QMap<int, Tileset*>::const_iterator i = mGidsToTileset.upperBound(gid);
-        --i; // Navigate one tileset back since upper bound finds the next
-        const int tileId = gid - i.key();
-        const Tileset *tileset = i.value();
-
-        result = tileset ? tileset->tileAt(tileId) : 0;
+        result = findTile(mGidsToTileset, gid);
         ok = true;
     }
 
     return result;
 }
 
+/**
+ * Rebuilds the GID table when tilesets have been added since it was last
+ * built. The table ends with the last tile of the last tileset, but is
+ * limited in size to guard against huge first GIDs. Tiles beyond the limit
+ * are still found through tileForGid().
+ */
+void MapReaderPrivate::updateGidTable()
+{
+    static const int MaxGidTableSize = 1 << 24;
+
+    if (!mGidTableDirty)
+        return;
+    mGidTableDirty = false;
+
+    mGidTable.clear();
+    if (mGidsToTileset.isEmpty())
+        return;
+
+    QMap<int, Tileset*>::const_iterator last = mGidsToTileset.constEnd();
+    --last;
+    const qint64 end = qint64(last.key()) + last.value()->tileCount();
+    const int size = int(qMin(end, qint64(MaxGidTableSize)));
+    if (size <= 0)
+        return;
+
+    mGidTable.resize(size);
+    Tile **table = mGidTable.data();
+    table[0] = 0;
+
+    QMap<int, Tileset*>::const_iterator it = mGidsToTileset.constBegin();
+    QMap<int, Tileset*>::const_iterator it_end = mGidsToTileset.constEnd();
+    for (; it != it_end; ++it) {
+        const int firstGid = it.key();
+        if (firstGid >= size)
+            break;
+
+        // IDs past the end of a tileset map to no tile, up to the next one
+        QMap<int, Tileset*>::const_iterator next = it;
+        ++next;
+        const int nextGid = (next == it_end) ? size : qMin(next.key(), size);
+        const Tileset *tileset = it.value();
+
+        for (int gid = qMax(firstGid, 1); gid < nextGid; ++gid)
+            table[gid] = tileset->tileAt(gid - firstGid);
+    }
+}
+
 ObjectGroup *MapReaderPrivate::readObjectGroup()
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == "objectgroup");
@@ -583,6 +1435,7 @@ ObjectGroup *MapReaderPrivate::readObjectGroup()
 
     ObjectGroup *objectGroup = new ObjectGroup(name, x, y, QRect(0, 0, width, height));
     readLayerAttributes(objectGroup, atts);
+    updateGidTable();
 
     const QString color = atts.value(QLatin1String("color")).toString();
     if (!color.isEmpty())
@@ -590,7 +1443,7 @@ ObjectGroup *MapReaderPrivate::readObjectGroup()
 
     while (readNextStartElement()) {
         if (xml.name() == "object")
-            objectGroup->addObject(readObject());
+            addObject(objectGroup, readObject());
         else if (xml.name() == "properties")
             objectGroup->mergeProperties(readProperties());
         else
@@ -636,7 +1489,7 @@ MapObject *MapReaderPrivate::readObject()
 
     if (gid) {
         bool ok;
-        Tile *tile = tileForGid(gid, ok);
+        Tile *tile = lookupTile(gid, ok);
         if (ok) {
             object->setTile(tile);
         } else {
@@ -654,6 +1507,29 @@ MapObject *MapReaderPrivate::readObject()
     return object;
 }
 
+/**
+ * Adds \a object to \a objectGroup, unless it lies outside of the region
+ * that is being read. Objects without a size only need to have their
+ * position in the region.
+ */
+void MapReaderPrivate::addObject(ObjectGroup *objectGroup, MapObject *object)
+{
+    if (!mRegion.isNull()) {
+        const QRectF bounds = object->bounds();
+        const QRectF region(mRegion);
+
+        if (bounds.right() < region.left()
+            || bounds.left() >= region.right()
+            || bounds.bottom() < region.top()
+            || bounds.top() >= region.bottom()) {
+            delete object;
+            return;
+        }
+    }
+
+    objectGroup->addObject(object);
+}
+
 Properties MapReaderPrivate::readProperties()
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == "properties");
@@ -692,6 +1568,336 @@ void MapReaderPrivate::readProperty(Properties *properties)
     properties->insert(propertyName, propertyValue);
 }
 
+static QRect readBinaryRect(QDataStream &in)
+{
+    qint32 x, y, width, height;
+    in >> x >> y >> width >> height;
+    return QRect(x, y, width, height);
+}
+
+static QColor readBinaryColor(QDataStream &in)
+{
+    quint8 valid;
+    quint32 rgba;
+    in >> valid >> rgba;
+    return valid ? QColor::fromRgba(rgba) : QColor();
+}
+
+static Properties readBinaryProperties(QDataStream &in)
+{
+    Properties properties;
+
+    quint32 count;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString name, value;
+        in >> name >> value;
+        properties.insert(name, value);
+    }
+
+    return properties;
+}
+
+static void readBinaryLayerAttributes(QDataStream &in, Layer *layer)
+{
+    double opacity;
+    quint8 visible;
+    in >> opacity >> visible;
+
+    layer->setOpacity(opacity);
+    layer->setVisible(visible);
+    layer->mergeProperties(readBinaryProperties(in));
+}
+
+/**
+ * Reads the binary map in \a data. The tile layer data is decoded straight
+ * from \a data, which needs to stay valid until this function returns.
+ */
+Map *MapReaderPrivate::readBinaryMap(const char *data, qint64 size)
+{
+    using namespace BinaryMapFormat;
+
+    const uchar *bytes = reinterpret_cast<const uchar*>(data);
+    if (size < HeaderSize + TrailerSize
+        || memcmp(data, Magic, sizeof(Magic)) != 0
+        || memcmp(data + size - sizeof(Magic), Magic, sizeof(Magic)) != 0) {
+        mError = tr("Not a binary map file.");
+        return 0;
+    }
+
+    const quint32 version = qFromLittleEndian<quint32>(bytes + 4);
+    if (version != Version) {
+        mError = tr("Unsupported binary map version: %1").arg(version);
+        return 0;
+    }
+
+    // The description follows the chunks, which end where it starts
+    const uchar *trailer = bytes + size - TrailerSize;
+    const quint64 descriptionOffset = qFromLittleEndian<quint64>(trailer);
+    const quint64 descriptionSize = qFromLittleEndian<quint64>(trailer + 8);
+    const quint64 descriptionEnd = size - TrailerSize;
+
+    if (descriptionOffset < quint64(HeaderSize)
+        || descriptionOffset > descriptionEnd
+        || descriptionSize != descriptionEnd - descriptionOffset
+        || descriptionSize > quint64(INT_MAX)) {
+        mError = tr("Corrupt binary map file.");
+        return 0;
+    }
+
+    QDataStream in(QByteArray::fromRawData(data + descriptionOffset,
+                                           int(descriptionSize)));
+    prepareStream(in);
+
+    quint8 orientation;
+    in >> orientation;
+    const QRect mapSize = readBinaryRect(in);
+    qint32 tileWidth, tileHeight;
+    in >> tileWidth >> tileHeight;
+
+    if (orientation == Map::Unknown || orientation > Map::Hexagonal) {
+        mError = tr("Unsupported map orientation: %1").arg(orientation);
+        return 0;
+    }
+
+    mMap = new Map(Map::Orientation(orientation), mapSize,
+                   tileWidth, tileHeight);
+    mMap->mergeProperties(readBinaryProperties(in));
+
+    quint32 tilesetCount;
+    in >> tilesetCount;
+    for (quint32 i = 0; i < tilesetCount && mError.isEmpty()
+                        && in.status() == QDataStream::Ok; ++i) {
+        if (Tileset *tileset = readBinaryTileset(in))
+            mMap->addTileset(tileset);
+    }
+
+    // The layers are only added to the map once the tile layers have been
+    // decoded, since adding a layer looks at its tiles.
+    QList<Layer*> layers;
+
+    quint32 layerCount;
+    in >> layerCount;
+    for (quint32 i = 0; i < layerCount && mError.isEmpty()
+                        && in.status() == QDataStream::Ok; ++i) {
+        quint8 layerType;
+        in >> layerType;
+
+        if (layerType == TileLayerType)
+            layers.append(readBinaryTileLayer(in, data, descriptionOffset));
+        else if (layerType == ObjectGroupType)
+            layers.append(readBinaryObjectGroup(in));
+        else if (in.status() == QDataStream::Ok)
+            mError = tr("Unknown layer type: %1").arg(layerType);
+    }
+
+    if (mError.isEmpty() && in.status() != QDataStream::Ok)
+        mError = tr("Corrupt binary map file.");
+
+    // Wait for the decoding layers even after an error, but report the
+    // error that came first
+    const QString error = mError;
+    const bool layerDataOk = finishLayerData();
+    if (!error.isEmpty())
+        mError = error;
+
+    foreach (Layer *layer, layers)
+        mMap->addLayer(layer);
+
+    // Clean up in case of error
+    if (!mError.isEmpty() || !layerDataOk) {
+        delete mMap;
+        mMap = 0;
+
+        // The tilesets are not owned by the map
+        qDeleteAll(mGidsToTileset.values());
+    }
+
+    return mMap;
+}
+
+Tileset *MapReaderPrivate::readBinaryTileset(QDataStream &in)
+{
+    qint32 firstGid;
+    QString source;
+    in >> firstGid >> source;
+
+    Tileset *tileset = 0;
+
+    if (source.isEmpty()) { // Not an external tileset
+        QString name, imageSource;
+        qint32 tileWidth, tileHeight, tileSpacing, margin;
+        in >> name >> tileWidth >> tileHeight >> tileSpacing >> margin
+           >> imageSource;
+        const QColor transparentColor = readBinaryColor(in);
+
+        if (in.status() != QDataStream::Ok)
+            return 0;
+
+        if (tileWidth <= 0 || tileHeight <= 0 || firstGid <= 0) {
+            mError = tr("Invalid tileset parameters for tileset"
+                        " '%1'").arg(name);
+            return 0;
+        }
+
+        tileset = new Tileset(name, tileWidth, tileHeight,
+                              tileSpacing, margin);
+        tileset->setTransparentColor(transparentColor);
+
+        if (!imageSource.isEmpty()) {
+            imageSource = p->resolveReference(imageSource, mPath);
+
+            if (!loadTilesetImage(tileset, imageSource)) {
+                mError = tr("Error loading tileset image:\n'%1'")
+                        .arg(imageSource);
+            }
+        }
+
+        quint32 tileCount;
+        in >> tileCount;
+        for (quint32 i = 0; i < tileCount && mError.isEmpty()
+                            && in.status() == QDataStream::Ok; ++i) {
+            qint32 id;
+            in >> id;
+            const Properties properties = readBinaryProperties(in);
+
+            if (id < 0 || id >= tileset->tileCount())
+                mError = tr("Invalid tile ID: %1").arg(id);
+            else
+                tileset->tileAt(id)->mergeProperties(properties);
+        }
+    } else { // External tileset
+        const QString absoluteSource = p->resolveReference(source, mPath);
+        QString error;
+        tileset = p->readExternalTileset(absoluteSource, &error);
+
+        if (!tileset) {
+            mError = tr("Error while loading tileset '%1': %2")
+                    .arg(absoluteSource, error);
+        }
+    }
+
+    if (tileset) {
+        mGidsToTileset.insert(firstGid, tileset);
+        mGidTableDirty = true;
+    }
+
+    return tileset;
+}
+
+/**
+ * Reads a tile layer and queues its chunks for decoding. The chunks are
+ * taken from \a data and have to lie before \a chunkDataEnd.
+ */
+TileLayer *MapReaderPrivate::readBinaryTileLayer(QDataStream &in,
+                                                 const char *data,
+                                                 qint64 chunkDataEnd)
+{
+    using namespace BinaryMapFormat;
+
+    QString name;
+    qint32 x, y;
+    in >> name >> x >> y;
+    const QRect size = readBinaryRect(in);
+
+    TileLayer *tileLayer = new TileLayer(name, x, y, size);
+    readBinaryLayerAttributes(in, tileLayer);
+    updateGidTable();
+
+    LayerData *layerData = createLayerData(tileLayer);
+
+    quint32 chunkCount;
+    in >> chunkCount;
+    for (quint32 i = 0; i < chunkCount && in.status() == QDataStream::Ok;
+         ++i) {
+        const QRect rect = readBinaryRect(in);
+        quint8 compression;
+        quint64 offset;
+        quint32 chunkSize;
+        in >> compression >> offset >> chunkSize;
+
+        if (in.status() != QDataStream::Ok)
+            break;
+
+        if (rect.width() <= 0 || rect.height() <= 0
+            || (compression != NoCompression
+                && compression != ZlibCompression)
+            || offset < quint64(HeaderSize)
+            || offset > quint64(chunkDataEnd)
+            || chunkSize > quint64(chunkDataEnd) - offset
+            || chunkSize > quint32(INT_MAX)) {
+            mError = tr("Corrupt layer data for layer '%1'").arg(name);
+            break;
+        }
+
+        // Chunks outside of the region are never looked at
+        if (!layerData->overlapsRegion(rect))
+            continue;
+
+        // The chunk refers to its data without copying it
+        LayerData::Chunk chunk;
+        chunk.rect = rect;
+        chunk.csv = false;
+        chunk.data = QByteArray::fromRawData(data + offset, int(chunkSize));
+        if (compression == ZlibCompression)
+            chunk.compression = QLatin1String("zlib");
+        chunk.lineNumber = 0;
+        chunk.columnNumber = 0;
+
+        layerData->chunks.append(chunk);
+    }
+
+
+    if (layerData->chunks.isEmpty() || !mError.isEmpty()
+        || in.status() != QDataStream::Ok)
+        delete layerData;
+    else
+        queueLayerData(layerData);
+
+    return tileLayer;
+}
+
+ObjectGroup *MapReaderPrivate::readBinaryObjectGroup(QDataStream &in)
+{
+    QString name;
+    qint32 x, y;
+    in >> name >> x >> y;
+    const QRect size = readBinaryRect(in);
+
+    ObjectGroup *objectGroup = new ObjectGroup(name, x, y, size);
+    readBinaryLayerAttributes(in, objectGroup);
+    objectGroup->setColor(readBinaryColor(in));
+    updateGidTable();
+
+    quint32 objectCount;
+    in >> objectCount;
+    for (quint32 i = 0; i < objectCount && mError.isEmpty()
+                        && in.status() == QDataStream::Ok; ++i) {
+        QString objectName, type;
+        qint32 gid;
+        double objectX, objectY, width, height;
+        in >> objectName >> type >> gid
+           >> objectX >> objectY >> width >> height;
+
+        MapObject *object = new MapObject(objectName, type, objectX, objectY,
+                                          width, height);
+        object->mergeProperties(readBinaryProperties(in));
+
+        if (gid) {
+            bool ok;
+            Tile *tile = lookupTile(gid, ok);
+            if (ok)
+                object->setTile(tile);
+            else
+                mError = tr("Invalid tile: %1").arg(gid);
+        }
+
+        addObject(objectGroup, object);
+    }
+
+    return objectGroup;
+}
+
 
 MapReader::MapReader()
     : d(new MapReaderPrivate(this))
@@ -705,16 +1911,64 @@ MapReader::~MapReader()
 
 Map *MapReader::readMap(QIODevice *device, const QString &path)
 {
+    if (MapReaderPrivate::isBinaryMap(device))
+        return readBinaryMap(device, path);
+
     return d->readMap(device, path);
 }
 
 Map *MapReader::readMap(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!d->openFile(&file))
+    QSharedPointer<QFile> file(new QFile(fileName));
+    if (!d->openFile(file.data(), QFile::ReadOnly))
+        return 0;
+
+    const QString path = QFileInfo(fileName).absolutePath();
+
+    // The file is read from a mapping when possible. It stays open for as
+    // long as any layer that is loaded on demand refers to the mapping.
+    const qint64 size = file->size();
+    if (size <= INT_MAX) {
+        if (const uchar *mapping = file->map(0, size)) {
+            const char *data = reinterpret_cast<const char*>(mapping);
+            if (MapReaderPrivate::isBinaryMap(file.data()))
+                return d->readBinaryMap(file, data, size, path);
+
+            return d->readMap(file, data, size, path);
+        }
+    }
+
+    return readMap(file.data(), path);
+}
+
+Map *MapReader::readBinaryMap(QIODevice *device, const QString &path)
+{
+    QBuffer *buffer = new QBuffer;
+    buffer->setData(device->readAll());
+
+    const QByteArray &data = buffer->data();
+    return d->readBinaryMap(QSharedPointer<QIODevice>(buffer),
+                            data.constData(), data.size(), path);
+}
+
+Map *MapReader::readBinaryMap(const QString &fileName)
+{
+    QSharedPointer<QFile> file(new QFile(fileName));
+    if (!d->openFile(file.data(), QFile::ReadOnly))
         return 0;
 
-    return readMap(&file, QFileInfo(fileName).absolutePath());
+    const QString path = QFileInfo(fileName).absolutePath();
+
+    // The mapping is only read from where the map needs it, and stays valid
+    // until the file is closed, which is when the last layer that is loaded
+    // on demand no longer needs it
+    const qint64 size = file->size();
+    if (const uchar *data = file->map(0, size)) {
+        return d->readBinaryMap(file, reinterpret_cast<const char*>(data),
+                                size, path);
+    }
+
+    return readBinaryMap(file.data(), path);
 }
 
 Tileset *MapReader::readTileset(QIODevice *device, const QString &path)
@@ -735,6 +1989,36 @@ Tileset *MapReader::readTileset(const QString &fileName)
     return tileset;
 }
 
+void MapReader::setLazyLoadingEnabled(bool enabled)
+{
+    d->mLazyLoading = enabled;
+}
+
+bool MapReader::isLazyLoadingEnabled() const
+{
+    return d->mLazyLoading;
+}
+
+void MapReader::setDeferredImageLoadingEnabled(bool enabled)
+{
+    d->mDeferredImageLoading = enabled;
+}
+
+bool MapReader::isDeferredImageLoadingEnabled() const
+{
+    return d->mDeferredImageLoading;
+}
+
+void MapReader::setRegion(const QRect &region)
+{
+    d->mRegion = region;
+}
+
+QRect MapReader::region() const
+{
+    return d->mRegion;
+}
+
 QString MapReader::errorString() const
 {
     return d->errorString();
@@ -751,13 +2035,18 @@ QString MapReader::resolveReference(const QString &reference,
 
 QImage MapReader::readExternalImage(const QString &source)
 {
-    return QImage(source);
+    return TilesetCache::instance()->image(source);
 }
 
 Tileset *MapReader::readExternalTileset(const QString &source,
                                         QString *error)
 {
+    if (!d->mDeferredImageLoading)
+        return TilesetCache::instance()->tileset(source, error);
+
+    // Tilesets with placeholder tiles are not shared through the cache
     MapReader reader;
+    reader.setDeferredImageLoadingEnabled(true);
     Tileset *tileset = reader.readTileset(source);
     if (!tileset)
         *error = reader.errorString();
@@ -24,6 +24,7 @@
 #include "tiled_global.h"
 
 #include <QImage>
+#include <QRect>
 
 class QFile;
 
@@ -51,7 +52,8 @@ public:
     /**
      * Reads a TMX map from the given \a device. Optionally a \a path can
      * be given, which will be used to resolve relative references to external
-     * images and tilesets.
+     * images and tilesets. Maps in the binary map format are recognized and
+     * read with readBinaryMap().
      *
      * Returns 0 and sets errorString() when reading failed.
      *
@@ -60,11 +62,35 @@ public:
     Map *readMap(QIODevice *device, const QString &path = QString());
 
     /**
-     * Reads a TMX map from the given \a fileName.
+     * Reads a TMX map from the given \a fileName. The file is mapped into
+     * memory and the Base64 and CSV encoded layer data is decoded straight
+     * from the mapping where possible.
      * \overload
      */
     Map *readMap(const QString &fileName);
 
+    /**
+     * Reads a map in the binary map format from the given \a device, which
+     * should not be opened in text mode. Optionally a \a path can be given,
+     * which will be used to resolve relative references to external images
+     * and tilesets.
+     *
+     * Returns 0 and sets errorString() when reading failed.
+     *
+     * The caller takes ownership over the newly created map.
+     *
+     * @see MapWriter::writeBinaryMap()
+     */
+    Map *readBinaryMap(QIODevice *device, const QString &path = QString());
+
+    /**
+     * Reads a map in the binary map format from the given \a fileName. The
+     * file is mapped into memory and the tile layer data is decoded straight
+     * from the mapping.
+     * \overload
+     */
+    Map *readBinaryMap(const QString &fileName);
+
     /**
      * Reads a TSX tileset from the given \a device. Optionally a \a path can
      * be given, which will be used to resolve relative references to external
@@ -87,6 +113,54 @@ public:
      */
     QString errorString() const;
 
+    /**
+     * Sets whether the tiles of tile layers are loaded on demand. When
+     * enabled, the encoded layer data is kept with each layer and only
+     * decoded once its tiles are first needed, so that layers that are never
+     * looked at, like hidden ones, are never decoded.
+     *
+     * Errors in the layer data can then no longer be reported by readMap().
+     * Instead, they are printed as warnings and the affected layer is left
+     * incomplete. Until a layer is loaded, it counts as using every tileset
+     * that its data could refer to. Cloning the map does not load any of the
+     * layers. Disabled by default.
+     *
+     * Layers that are not loaded yet refer to the mapping of the file they
+     * were read from, which stays open until they are loaded. MapWriter
+     * loads them before saving over the file, but the file should not be
+     * changed by other means while the map is open.
+     *
+     * \sa TileLayer::setLoader()
+     */
+    void setLazyLoadingEnabled(bool enabled);
+    bool isLazyLoadingEnabled() const;
+
+    /**
+     * Sets whether decoding tileset images is left to the caller. When
+     * enabled, only the size of each tileset image is read, which is enough
+     * to create the tiles. They show a placeholder until the image is loaded
+     * into the tileset, which can be done on a worker thread with the help of
+     * Tileset::atlasImage(). Such tilesets are recognized by
+     * Tileset::hasPlaceholderTiles(). Disabled by default.
+     *
+     * Images whose size can't be read without decoding them are still loaded
+     * right away, through readExternalImage().
+     */
+    void setDeferredImageLoadingEnabled(bool enabled);
+    bool isDeferredImageLoadingEnabled() const;
+
+    /**
+     * Restricts reading to the given \a region of the map, in tiles. Only
+     * the tiles within the region are placed and only the objects touching
+     * it are kept, while the map and its layers keep their full size and
+     * position. Layer data is only decoded as far as it overlaps the region
+     * and chunks of layer data outside of it are skipped entirely.
+     *
+     * A null rectangle, the default, reads the whole map.
+     */
+    void setRegion(const QRect &region);
+    QRect region() const;
+
 protected:
     /**
      * Called for each \a reference to an external file. Should return the path
@@ -98,12 +172,16 @@ protected:
 
     /**
      * Called when an external image is encountered while a tileset is loaded.
+     * The default implementation gets the image from the TilesetCache.
      */
     virtual QImage readExternalImage(const QString &source);
 
     /**
      * Called when an external tileset is encountered while a map is loaded.
-     * The default implementation just calls readTileset() on a new MapReader.
+     * The default implementation gets a copy of the tileset from the
+     * TilesetCache, which calls readTileset() on a new MapReader when needed.
+     * With deferred image loading, the tileset is always read by a new
+     * MapReader that defers image loading as well.
      *
      * If an error occurred, the \a error parameter should be set to the error
      * message.
@@ -22,6 +22,7 @@
 
 #include "mapwriter.h"
 
+#include "binarymapformat.h"
 #include "compression.h"
 #include "map.h"
 #include "mapobject.h"
@@ -31,6 +32,7 @@
 #include "tileset.h"
 
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDir>
 #include <QMap>
 #include <QXmlStreamWriter>
@@ -54,17 +56,25 @@ public:
     void writeTileset(const Tileset *tileset, QIODevice *device,
                       const QString &path);
 
+    void writeBinaryMap(const Map *map, QIODevice *device,
+                        const QString &path);
+
     bool openFile(QFile *file);
 
     QString mError;
     MapWriter::LayerDataFormat mLayerDataFormat;
     bool mDtdEnabled;
+    bool mChunkedLayerData;
 
 private:
     void writeMap(QXmlStreamWriter &w, const Map *map);
     void writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
                       int firstGid);
     void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer);
+    void writeTileLayerData(QXmlStreamWriter &w, const TileLayer *tileLayer,
+                            const QRect &rect, int depth);
+    QByteArray binaryTileData(const TileLayer *tileLayer,
+                              const QRect &rect) const;
     void writeLayerAttributes(QXmlStreamWriter &w, const Layer *layer);
     int gidForTile(const Tile *tile) const;
     void writeObjectGroup(QXmlStreamWriter &w, const ObjectGroup *objectGroup);
@@ -72,6 +82,15 @@ private:
     void writeProperties(QXmlStreamWriter &w,
                          const Properties &properties);
 
+    void writeBinaryTileset(QDataStream &out, const Tileset *tileset,
+                            int firstGid);
+    void writeBinaryTileLayer(QDataStream &out, QDataStream &description,
+                              const TileLayer *tileLayer, qint64 &offset);
+    void writeBinaryObjectGroup(QDataStream &out,
+                                const ObjectGroup *objectGroup);
+
+    QString relativeFileName(const QString &fileName) const;
+
     QDir mMapDir;     // The directory in which the map is being saved
     QMap<int, const Tileset*> mFirstGidToTileset;
     bool mUseAbsolutePaths;
@@ -84,6 +103,7 @@ private:
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(MapWriter::Base64Gzip)
     , mDtdEnabled(false)
+    , mChunkedLayerData(false)
     , mUseAbsolutePaths(false)
 {
 }
@@ -98,6 +118,18 @@ bool MapWriterPrivate::openFile(QFile *file)
     return true;
 }
 
+/**
+ * Loads the tile layers of \a map that are loaded on demand, since they may
+ * still refer to the file that is about to be overwritten.
+ */
+static void loadTileLayers(const Map *map)
+{
+    foreach (Layer *layer, map->layers()) {
+        if (TileLayer *tileLayer = layer->asTileLayer())
+            tileLayer->load();
+    }
+}
+
 static QXmlStreamWriter *createWriter(QIODevice *device)
 {
     QXmlStreamWriter *writer = new QXmlStreamWriter(device);
@@ -204,10 +236,7 @@ void MapWriterPrivate::writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
 
     const QString &fileName = tileset->fileName();
     if (!fileName.isEmpty()) {
-        QString source = fileName;
-        if (!mUseAbsolutePaths)
-            source = mMapDir.relativeFilePath(source);
-        w.writeAttribute(QLatin1String("source"), source);
+        w.writeAttribute(QLatin1String("source"), relativeFileName(fileName));
 
         // Tileset is external, so no need to write any of the stuff below
         w.writeEndElement();
@@ -231,10 +260,8 @@ void MapWriterPrivate::writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
     const QString &imageSource = tileset->imageSource();
     if (!imageSource.isEmpty()) {
         w.writeStartElement(QLatin1String("image"));
-        QString source = imageSource;
-        if (!mUseAbsolutePaths)
-            source = mMapDir.relativeFilePath(source);
-        w.writeAttribute(QLatin1String("source"), source);
+        w.writeAttribute(QLatin1String("source"),
+                         relativeFileName(imageSource));
 
         const QColor transColor = tileset->transparentColor();
         if (transColor.isValid())
@@ -265,6 +292,18 @@ void MapWriterPrivate::writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
     w.writeEndElement();
 }
 
+/**
+ * Returns the size of \a layer as written to TMX files, which is measured
+ * from the origin of the layer. Chunks may extend a tile layer into negative
+ * coordinates, which the reader adds back as it places their tiles, so that
+ * the layer keeps its bounds.
+ */
+static QSize tmxLayerSize(const Layer *layer)
+{
+    const QRect bounds = layer->bounds().translated(-layer->x(), -layer->y());
+    return QSize(qMax(0, bounds.right() + 1), qMax(0, bounds.bottom() + 1));
+}
+
 void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
                                       const TileLayer *tileLayer)
 {
@@ -295,9 +334,38 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
     if (!compression.isEmpty())
         w.writeAttribute(QLatin1String("compression"), compression);
 
+    if (mChunkedLayerData) {
+        foreach (const QRect &rect, tileLayer->chunkRects()) {
+            w.writeStartElement(QLatin1String("chunk"));
+            w.writeAttribute(QLatin1String("x"), QString::number(rect.x()));
+            w.writeAttribute(QLatin1String("y"), QString::number(rect.y()));
+            w.writeAttribute(QLatin1String("width"),
+                             QString::number(rect.width()));
+            w.writeAttribute(QLatin1String("height"),
+                             QString::number(rect.height()));
+            writeTileLayerData(w, tileLayer, rect, 4);
+            w.writeEndElement(); // </chunk>
+        }
+    } else {
+        writeTileLayerData(w, tileLayer,
+                           QRect(QPoint(0, 0), tmxLayerSize(tileLayer)), 3);
+    }
+
+    w.writeEndElement(); // </data>
+    w.writeEndElement(); // </layer>
+}
+
+/**
+ * Writes the tiles within \a rect in the current layer data format. The
+ * \a depth is the indentation of the data in case it is written as text.
+ */
+void MapWriterPrivate::writeTileLayerData(QXmlStreamWriter &w,
+                                          const TileLayer *tileLayer,
+                                          const QRect &rect, int depth)
+{
     if (mLayerDataFormat == MapWriter::XML) {
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
                 const int gid = gidForTile(tileLayer->tileAt(x, y));
                 w.writeStartElement(QLatin1String("tile"));
                 w.writeAttribute(QLatin1String("gid"), QString::number(gid));
@@ -307,12 +375,11 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
     } else if (mLayerDataFormat == MapWriter::CSV) {
         QString tileData;
 
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
                 const int gid = gidForTile(tileLayer->tileAt(x, y));
                 tileData.append(QString::number(gid));
-                if (x != tileLayer->width() - 1
-                    || y != tileLayer->height() - 1)
+                if (x != rect.right() || y != rect.bottom())
                     tileData.append(QLatin1String(","));
             }
             tileData.append(QLatin1String("\n"));
@@ -321,40 +388,53 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
         w.writeCharacters(QLatin1String("\n"));
         w.writeCharacters(tileData);
     } else {
-        QByteArray tileData;
-        tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const int gid = gidForTile(tileLayer->tileAt(x, y));
-                tileData.append((char) (gid));
-                tileData.append((char) (gid >> 8));
-                tileData.append((char) (gid >> 16));
-                tileData.append((char) (gid >> 24));
-            }
-        }
+        QByteArray tileData = binaryTileData(tileLayer, rect);
 
         if (mLayerDataFormat == MapWriter::Base64Gzip)
             tileData = compress(tileData, Gzip);
         else if (mLayerDataFormat == MapWriter::Base64Zlib)
             tileData = compress(tileData, Zlib);
 
-        w.writeCharacters(QLatin1String("\n   "));
+        // Indent the data like the elements written with auto-formatting
+        const QString indent(depth - 1, QLatin1Char(' '));
+        w.writeCharacters(QLatin1Char('\n') + indent + QLatin1Char(' '));
         w.writeCharacters(QString::fromLatin1(tileData.toBase64()));
-        w.writeCharacters(QLatin1String("\n  "));
+        w.writeCharacters(QLatin1Char('\n') + indent);
     }
 
-    w.writeEndElement(); // </data>
-    w.writeEndElement(); // </layer>
+}
+
+/**
+ * Returns the global tile IDs of the tiles within \a rect as little-endian
+ * 32-bit values.
+ */
+QByteArray MapWriterPrivate::binaryTileData(const TileLayer *tileLayer,
+                                            const QRect &rect) const
+{
+    QByteArray tileData;
+    tileData.reserve(rect.height() * rect.width() * 4);
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            const int gid = gidForTile(tileLayer->tileAt(x, y));
+            tileData.append((char) (gid));
+            tileData.append((char) (gid >> 8));
+            tileData.append((char) (gid >> 16));
+            tileData.append((char) (gid >> 24));
+        }
+    }
+
+    return tileData;
 }
 
 void MapWriterPrivate::writeLayerAttributes(QXmlStreamWriter &w,
                                             const Layer *layer)
 {
+    const QSize size = tmxLayerSize(layer);
     w.writeAttribute(QLatin1String("name"), layer->name());
-    w.writeAttribute(QLatin1String("width"), QString::number(layer->width()));
+    w.writeAttribute(QLatin1String("width"), QString::number(size.width()));
     w.writeAttribute(QLatin1String("height"),
-                     QString::number(layer->height()));
+                     QString::number(size.height()));
     const int x = layer->x();
     const int y = layer->y();
     const qreal opacity = layer->opacity();
@@ -485,6 +565,188 @@ void MapWriterPrivate::writeProperties(QXmlStreamWriter &w,
     w.writeEndElement();
 }
 
+/**
+ * Returns the given file name relative to the directory of the map, unless
+ * absolute paths are being used.
+ */
+QString MapWriterPrivate::relativeFileName(const QString &fileName) const
+{
+    if (mUseAbsolutePaths)
+        return fileName;
+    return mMapDir.relativeFilePath(fileName);
+}
+
+static void writeBinaryRect(QDataStream &out, const QRect &rect)
+{
+    out << qint32(rect.x()) << qint32(rect.y())
+        << qint32(rect.width()) << qint32(rect.height());
+}
+
+static void writeBinaryColor(QDataStream &out, const QColor &color)
+{
+    out << quint8(color.isValid()) << quint32(color.rgba());
+}
+
+static void writeBinaryProperties(QDataStream &out,
+                                  const Properties &properties)
+{
+    out << quint32(properties.size());
+
+    Properties::const_iterator it = properties.constBegin();
+    Properties::const_iterator it_end = properties.constEnd();
+    for (; it != it_end; ++it)
+        out << it.key() << it.value();
+}
+
+static void writeBinaryLayerAttributes(QDataStream &out, const Layer *layer)
+{
+    // The area of the layer is stored relative to its position
+    out << layer->name() << qint32(layer->x()) << qint32(layer->y());
+    writeBinaryRect(out, layer->bounds().translated(-layer->x(),
+                                                    -layer->y()));
+    out << double(layer->opacity()) << quint8(layer->isVisible());
+    writeBinaryProperties(out, layer->properties());
+}
+
+void MapWriterPrivate::writeBinaryMap(const Map *map, QIODevice *device,
+                                      const QString &path)
+{
+    mMapDir = QDir(path);
+    mUseAbsolutePaths = path.isEmpty();
+
+    QDataStream out(device);
+    BinaryMapFormat::prepareStream(out);
+    out.writeRawData(BinaryMapFormat::Magic, 4);
+    out << quint32(BinaryMapFormat::Version);
+
+    // The chunks are written while the description is being put together,
+    // since the description needs to know where they ended up
+    qint64 offset = BinaryMapFormat::HeaderSize;
+
+    QByteArray description;
+    QDataStream d(&description, QIODevice::WriteOnly);
+    BinaryMapFormat::prepareStream(d);
+
+    d << quint8(map->orientation());
+    writeBinaryRect(d, map->size());
+    d << qint32(map->tileWidth()) << qint32(map->tileHeight());
+    writeBinaryProperties(d, map->properties());
+
+    mFirstGidToTileset.clear();
+    d << quint32(map->tilesets().size());
+    int firstGid = 1;
+    foreach (const Tileset *tileset, map->tilesets()) {
+        writeBinaryTileset(d, tileset, firstGid);
+        mFirstGidToTileset.insert(firstGid, tileset);
+        firstGid += tileset->tileCount();
+    }
+
+    d << quint32(map->layerCount());
+    foreach (const Layer *layer, map->layers()) {
+        if (dynamic_cast<const TileLayer*>(layer) != 0)
+            writeBinaryTileLayer(out, d, static_cast<const TileLayer*>(layer),
+                                 offset);
+        else if (dynamic_cast<const ObjectGroup*>(layer) != 0)
+            writeBinaryObjectGroup(d, static_cast<const ObjectGroup*>(layer));
+    }
+
+    out.writeRawData(description.constData(), description.size());
+    out << quint64(offset) << quint64(description.size());
+    out.writeRawData(BinaryMapFormat::Magic, 4);
+}
+
+void MapWriterPrivate::writeBinaryTileset(QDataStream &out,
+                                          const Tileset *tileset,
+                                          int firstGid)
+{
+    out << qint32(firstGid);
+
+    // External tilesets are only referred to by their file name
+    const QString &fileName = tileset->fileName();
+    if (!fileName.isEmpty()) {
+        out << relativeFileName(fileName);
+        return;
+    }
+    out << QString();
+
+    out << tileset->name()
+        << qint32(tileset->tileWidth()) << qint32(tileset->tileHeight())
+        << qint32(tileset->tileSpacing()) << qint32(tileset->margin());
+
+    const QString &imageSource = tileset->imageSource();
+    out << (imageSource.isEmpty() ? QString() : relativeFileName(imageSource));
+    writeBinaryColor(out, tileset->transparentColor());
+
+    // Write the properties for those tiles that have them
+    QList<const Tile*> tilesWithProperties;
+    for (int i = 0; i < tileset->tileCount(); ++i) {
+        const Tile *tile = tileset->tileAt(i);
+        if (!tile->properties().isEmpty())
+            tilesWithProperties.append(tile);
+    }
+
+    out << quint32(tilesWithProperties.size());
+    foreach (const Tile *tile, tilesWithProperties) {
+        out << qint32(tile->id());
+        writeBinaryProperties(out, tile->properties());
+    }
+}
+
+/**
+ * Writes the chunks of the tile layer to \a out, starting at \a offset, and
+ * its description including the index of the chunks to \a description.
+ */
+void MapWriterPrivate::writeBinaryTileLayer(QDataStream &out,
+                                            QDataStream &description,
+                                            const TileLayer *tileLayer,
+                                            qint64 &offset)
+{
+    // Only the uncompressed formats store the chunks uncompressed
+    const bool compressed = mLayerDataFormat == MapWriter::Base64Gzip
+            || mLayerDataFormat == MapWriter::Base64Zlib;
+
+    description << quint8(BinaryMapFormat::TileLayerType);
+    writeBinaryLayerAttributes(description, tileLayer);
+
+    const QVector<QRect> chunkRects = tileLayer->chunkRects();
+    description << quint32(chunkRects.size());
+
+    foreach (const QRect &rect, chunkRects) {
+        QByteArray tileData = binaryTileData(tileLayer, rect);
+        if (compressed)
+            tileData = compress(tileData, Zlib);
+
+        out.writeRawData(tileData.constData(), tileData.size());
+
+        writeBinaryRect(description, rect);
+        description << quint8(compressed ? BinaryMapFormat::ZlibCompression
+                                         : BinaryMapFormat::NoCompression)
+                    << quint64(offset) << quint32(tileData.size());
+
+        offset += tileData.size();
+    }
+}
+
+void MapWriterPrivate::writeBinaryObjectGroup(QDataStream &out,
+                                              const ObjectGroup *objectGroup)
+{
+    out << quint8(BinaryMapFormat::ObjectGroupType);
+    writeBinaryLayerAttributes(out, objectGroup);
+    writeBinaryColor(out, objectGroup->color());
+
+    // Objects keep their position in tile coordinates
+    out << quint32(objectGroup->objects().size());
+    foreach (const MapObject *mapObject, objectGroup->objects()) {
+        const QRectF bounds = mapObject->bounds();
+
+        out << mapObject->name() << mapObject->type()
+            << qint32(gidForTile(mapObject->tile()))
+            << double(bounds.x()) << double(bounds.y())
+            << double(bounds.width()) << double(bounds.height());
+        writeBinaryProperties(out, mapObject->properties());
+    }
+}
+
 
 MapWriter::MapWriter()
     : d(new MapWriterPrivate)
@@ -504,6 +766,8 @@ void MapWriter::writeMap(const Map *map, QIODevice *device,
 
 bool MapWriter::writeMap(const Map *map, const QString &fileName)
 {
+    loadTileLayers(map);
+
     QFile file(fileName);
     if (!d->openFile(&file))
         return false;
@@ -540,6 +804,30 @@ bool MapWriter::writeTileset(const Tileset *tileset, const QString &fileName)
     return true;
 }
 
+void MapWriter::writeBinaryMap(const Map *map, QIODevice *device,
+                               const QString &path)
+{
+    d->writeBinaryMap(map, device, path);
+}
+
+bool MapWriter::writeBinaryMap(const Map *map, const QString &fileName)
+{
+    loadTileLayers(map);
+
+    QFile file(fileName);
+    if (!d->openFile(&file))
+        return false;
+
+    writeBinaryMap(map, &file, QFileInfo(fileName).absolutePath());
+
+    if (file.error() != QFile::NoError) {
+        d->mError = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
 QString MapWriter::errorString() const
 {
     return d->mError;
@@ -564,3 +852,13 @@ bool MapWriter::isDtdEnabled() const
 {
     return d->mDtdEnabled;
 }
+
+void MapWriter::setChunkedLayerDataEnabled(bool enabled)
+{
+    d->mChunkedLayerData = enabled;
+}
+
+bool MapWriter::isChunkedLayerDataEnabled() const
+{
+    return d->mChunkedLayerData;
+}
@@ -84,6 +84,29 @@ public:
      */
     bool writeTileset(const Tileset *tileset, const QString &fileName);
 
+    /**
+     * Writes a map in the binary map format to the given \a device, which
+     * should not be opened in text mode. The tile layers are stored in
+     * chunks, compressed with zlib unless an uncompressed layer data format
+     * has been set. Optionally a \a path can be given, which will be used to
+     * create relative references to external images and tilesets.
+     *
+     * Error checking will need to be done on the \a device after calling this
+     * function.
+     *
+     * @see MapReader::readBinaryMap()
+     */
+    void writeBinaryMap(const Map *map, QIODevice *device,
+                        const QString &path = QString());
+
+    /**
+     * Writes a map in the binary map format to the given \a fileName.
+     *
+     * Returns false and sets errorString() when writing failed.
+     * \overload
+     */
+    bool writeBinaryMap(const Map *map, const QString &fileName);
+
     /**
      * Returns the error message for the last occurred error.
      */
@@ -112,6 +135,15 @@ public:
     void setDtdEnabled(bool enabled);
     bool isDtdEnabled() const;
 
+    /**
+     * Sets whether tile layer data is written as a list of chunks. Only the
+     * chunks that contain tiles are written, which saves a lot of space for
+     * sparse layers. Disabled by default, since other tools may not support
+     * reading chunks.
+     */
+    void setChunkedLayerDataEnabled(bool enabled);
+    bool isChunkedLayerDataEnabled() const;
+
 private:
     Internal::MapWriterPrivate *d;
 };
@@ -60,11 +60,11 @@ QRectF OrthogonalRenderer::boundingRect(const MapObject *object) const
     // The -2 and +3 are to account for the pen width and shadow
     if (object->tile()) {
         const QPointF bottomLeft = rect.topLeft();
-        const QPixmap &img = object->tile()->image();
+        const Tile *tile = object->tile();
         return QRectF(bottomLeft.x(),
-                      bottomLeft.y() - img.height(),
-                      img.width(),
-                      img.height()).adjusted(-1, -1, 1, 1);
+                      bottomLeft.y() - tile->height(),
+                      tile->width(),
+                      tile->height()).adjusted(-1, -1, 1, 1);
     } else if (rect.isNull()) {
         return rect.adjusted(-15 - 2, -25 - 2, 10 + 3, 10 + 3);
     } else {
@@ -157,10 +157,12 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
             if (!tile)
                 continue;
 
-            const QPixmap &img = tile->image();
+            const QRect &source = tile->atlasRect();
             painter->drawPixmap(x * tileWidth,
-                                (y + 1) * tileHeight - img.height(),
-                                img);
+                                (y + 1) * tileHeight - source.height(),
+                                tile->atlas(),
+                                source.x(), source.y(),
+                                source.width(), source.height());
         }
     }
 
@@ -194,17 +196,17 @@ void OrthogonalRenderer::drawMapObject(QPainter *painter,
 
     if (object->tile())
     {
-        const QPixmap &img = object->tile()->image();
-        const QPoint paintOrigin(0, -img.height());
-        painter->drawPixmap(paintOrigin, img);
+        const Tile *tile = object->tile();
+        const QPoint paintOrigin(0, -tile->height());
+        painter->drawPixmap(paintOrigin, tile->atlas(), tile->atlasRect());
 
         QPen pen(Qt::SolidLine);
         painter->setPen(pen);
-        painter->drawRect(QRect(paintOrigin, img.size()));
+        painter->drawRect(QRect(paintOrigin, tile->size()));
         pen.setStyle(Qt::DotLine);
         pen.setColor(color);
         painter->setPen(pen);
-        painter->drawRect(QRect(paintOrigin, img.size()));
+        painter->drawRect(QRect(paintOrigin, tile->size()));
     }
     else
     {
@@ -0,0 +1,150 @@
+/*
+ * regionbuilder.cpp
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "regionbuilder.h"
+
+#include <QtAlgorithms>
+
+using namespace Tiled;
+
+void RegionBuilder::addSpan(int x, int y, int width)
+{
+    if (width <= 0)
+        return;
+
+    const int right = x + width - 1;
+
+    // Extend the previous span when continuing along the same row
+    if (!mSpans.isEmpty()) {
+        Span &last = mSpans.last();
+        if (last.y == y && x >= last.left && x <= last.right + 1) {
+            if (right > last.right)
+                last.right = right;
+            return;
+        }
+    }
+
+    Span span;
+    span.y = y;
+    span.left = x;
+    span.right = right;
+    mSpans.append(span);
+}
+
+void RegionBuilder::addRect(const QRect &rect)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        addSpan(rect.left(), y, rect.width());
+}
+
+bool RegionBuilder::spanLessThan(const Span &a, const Span &b)
+{
+    if (a.y != b.y)
+        return a.y < b.y;
+    return a.left < b.left;
+}
+
+/**
+ * The spans are sorted and merged per row, after which consecutive rows with
+ * identical spans are joined into bands. The resulting rectangles are in the
+ * banded y-x order expected by QRegion::setRects().
+ */
+QRegion RegionBuilder::region() const
+{
+    QRegion region;
+    if (mSpans.isEmpty())
+        return region;
+
+    QVector<Span> spans = mSpans;
+    qSort(spans.begin(), spans.end(), spanLessThan);
+
+    // Merge overlapping and touching spans within each row
+    int count = 0;
+    for (int i = 1; i < spans.size(); ++i) {
+        Span &last = spans[count];
+        const Span &span = spans.at(i);
+        if (span.y == last.y && span.left <= last.right + 1) {
+            if (span.right > last.right)
+                last.right = span.right;
+        } else {
+            spans[++count] = span;
+        }
+    }
+    spans.resize(count + 1);
+
+    QVector<QRect> rects;
+    rects.reserve(spans.size());
+
+    // The spans of the current band are spans[bandStart, bandEnd), covering
+    // the rows from bandTop to bandBottom
+    int bandStart = 0;
+    int bandEnd = 0;
+    int bandTop = spans.first().y;
+    int bandBottom = bandTop;
+
+    int rowStart = 0;
+    while (rowStart < spans.size()) {
+        const int y = spans.at(rowStart).y;
+        int rowEnd = rowStart + 1;
+        while (rowEnd < spans.size() && spans.at(rowEnd).y == y)
+            ++rowEnd;
+
+        bool sameAsBand = false;
+        if (rowStart > 0 && y == bandBottom + 1
+                && rowEnd - rowStart == bandEnd - bandStart) {
+            sameAsBand = true;
+            for (int i = 0; i < rowEnd - rowStart; ++i) {
+                const Span &a = spans.at(bandStart + i);
+                const Span &b = spans.at(rowStart + i);
+                if (a.left != b.left || a.right != b.right) {
+                    sameAsBand = false;
+                    break;
+                }
+            }
+        }
+
+        if (sameAsBand) {
+            bandBottom = y;
+        } else {
+            for (int i = bandStart; i < bandEnd; ++i) {
+                const Span &span = spans.at(i);
+                rects.append(QRect(span.left, bandTop,
+                                   span.right - span.left + 1,
+                                   bandBottom - bandTop + 1));
+            }
+            bandStart = rowStart;
+            bandEnd = rowEnd;
+            bandTop = y;
+            bandBottom = y;
+        }
+
+        rowStart = rowEnd;
+    }
+
+    for (int i = bandStart; i < bandEnd; ++i) {
+        const Span &span = spans.at(i);
+        rects.append(QRect(span.left, bandTop,
+                           span.right - span.left + 1,
+                           bandBottom - bandTop + 1));
+    }
+
+    region.setRects(rects.constData(), rects.size());
+    return region;
+}
@@ -0,0 +1,86 @@
+/*
+ * regionbuilder.h
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REGIONBUILDER_H
+#define REGIONBUILDER_H
+
+#include "tiled_global.h"
+
+#include <QRegion>
+#include <QVector>
+
+namespace Tiled {
+
+/**
+ * Collects horizontal spans of cells and turns them into a QRegion in a
+ * single pass. Adding cells one by one to a QRegion is very slow for large
+ * areas, since the region is rebuilt on every addition.
+ *
+ * Spans may be added in any order and may overlap. Adding cells from left to
+ * right along a row is cheapest, since those are merged as they come in.
+ */
+class TILEDSHARED_EXPORT RegionBuilder
+{
+public:
+    /**
+     * Adds the cell at (\a x, \a y).
+     */
+    void addPoint(int x, int y) { addSpan(x, y, 1); }
+
+    /**
+     * Adds \a width cells on row \a y, starting at \a x.
+     */
+    void addSpan(int x, int y, int width);
+
+    /**
+     * Adds all cells covered by the given rectangle.
+     */
+    void addRect(const QRect &rect);
+
+    /**
+     * Returns whether no cells have been added yet.
+     */
+    bool isEmpty() const { return mSpans.isEmpty(); }
+
+    /**
+     * Removes all cells that have been added so far.
+     */
+    void clear() { mSpans.clear(); }
+
+    /**
+     * Returns the region covering all the cells that have been added.
+     */
+    QRegion region() const;
+
+private:
+    struct Span {
+        int y;
+        int left;
+        int right;
+    };
+
+    static bool spanLessThan(const Span &a, const Span &b);
+
+    QVector<Span> mSpans;
+};
+
+} // namespace Tiled
+
+#endif // REGIONBUILDER_H
@@ -36,7 +36,20 @@ public:
     Tile(const QPixmap &image, int id, Tileset *tileset):
         mId(id),
         mTileset(tileset),
-        mImage(image)
+        mAtlas(image),
+        mAtlasRect(image.rect())
+    {}
+
+    /**
+     * Constructs a tile that shows the part \a atlasRect of the \a atlas,
+     * which is usually shared by all the tiles in a tileset.
+     */
+    Tile(const QPixmap &atlas, const QRect &atlasRect, int id,
+         Tileset *tileset):
+        mId(id),
+        mTileset(tileset),
+        mAtlas(atlas),
+        mAtlasRect(atlasRect)
     {}
 
     /**
@@ -50,29 +63,65 @@ public:
     Tileset *tileset() const { return mTileset; }
 
     /**
-     * Returns the image of this tile.
+     * Returns the image of this tile as a separate pixmap, which is copied
+     * out of the atlas on every call. For drawing the tile, use the atlas()
+     * with the atlasRect() instead.
      */
-    const QPixmap &image() const { return mImage; }
+    QPixmap image() const
+    {
+        if (mAtlasRect == mAtlas.rect())
+            return mAtlas;
+        return mAtlas.copy(mAtlasRect);
+    }
 
     /**
      * Sets the image of this tile.
      */
-    void setImage(const QPixmap &image) { mImage = image; }
+    void setImage(const QPixmap &image)
+    {
+        mAtlas = image;
+        mAtlasRect = image.rect();
+    }
+
+    /**
+     * Sets the image of this tile to the part \a atlasRect of the \a atlas.
+     */
+    void setImage(const QPixmap &atlas, const QRect &atlasRect)
+    {
+        mAtlas = atlas;
+        mAtlasRect = atlasRect;
+    }
+
+    /**
+     * Returns the pixmap that contains the image of this tile.
+     */
+    const QPixmap &atlas() const { return mAtlas; }
+
+    /**
+     * Returns the part of the atlas() that is the image of this tile.
+     */
+    const QRect &atlasRect() const { return mAtlasRect; }
 
     /**
      * Returns the width of this tile.
      */
-    int width() const { return mImage.width(); }
+    int width() const { return mAtlasRect.width(); }
 
     /**
      * Returns the height of this tile.
      */
-    int height() const { return mImage.height(); }
+    int height() const { return mAtlasRect.height(); }
+
+    /**
+     * Returns the size of this tile.
+     */
+    QSize size() const { return mAtlasRect.size(); }
 
 private:
     int mId;
     Tileset *mTileset;
-    QPixmap mImage;
+    QPixmap mAtlas;
+    QRect mAtlasRect;
 };
 
 } // namespace Tiled
@@ -0,0 +1,233 @@
+/*
+ * tilechunk.cpp
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilechunk.h"
+
+#include <cstring>
+
+using namespace Tiled;
+
+// Beyond these sizes a palette no longer saves memory compared to the next
+// encoding up.
+static const int MaxPalette8 = 256;
+static const int MaxPalette16 =
+        (TileChunk::CellCount * (sizeof(Tile*) - sizeof(quint16)))
+        / sizeof(Tile*);
+
+TileChunk::TileChunk(bool compact):
+    mEncoding(compact ? Palette8 : Direct),
+    mCount(0),
+    mLastIndex(0)
+{
+    if (mEncoding == Palette8) {
+        mPalette.append(0);
+        mCells.indices8 = new quint8[CellCount];
+        std::memset(mCells.indices8, 0, CellCount * sizeof(quint8));
+    } else {
+        mCells.tiles = new Tile*[CellCount];
+        std::memset(mCells.tiles, 0, CellCount * sizeof(Tile*));
+    }
+}
+
+TileChunk::TileChunk(const TileChunk &other):
+    QSharedData(other),
+    mEncoding(other.mEncoding),
+    mCount(other.mCount),
+    mLastIndex(other.mLastIndex),
+    mPalette(other.mPalette)
+{
+    switch (mEncoding) {
+    case Palette8:
+        mCells.indices8 = new quint8[CellCount];
+        std::memcpy(mCells.indices8, other.mCells.indices8,
+                    CellCount * sizeof(quint8));
+        break;
+    case Palette16:
+        mCells.indices16 = new quint16[CellCount];
+        std::memcpy(mCells.indices16, other.mCells.indices16,
+                    CellCount * sizeof(quint16));
+        break;
+    case Direct:
+        mCells.tiles = new Tile*[CellCount];
+        std::memcpy(mCells.tiles, other.mCells.tiles,
+                    CellCount * sizeof(Tile*));
+        break;
+    }
+}
+
+TileChunk::~TileChunk()
+{
+    switch (mEncoding) {
+    case Palette8:
+        delete[] mCells.indices8;
+        break;
+    case Palette16:
+        delete[] mCells.indices16;
+        break;
+    case Direct:
+        delete[] mCells.tiles;
+        break;
+    }
+}
+
+Tile *TileChunk::setTile(int x, int y, Tile *tile)
+{
+    const int i = y * Size + x;
+    Tile *previous = tileAt(x, y);
+    if (previous == tile)
+        return previous;
+
+    if (previous && !tile)
+        --mCount;
+    else if (!previous && tile)
+        ++mCount;
+
+    // Looking up the palette index may change the encoding
+    const int index = (mEncoding != Direct) ? paletteIndex(tile) : -1;
+
+    switch (mEncoding) {
+    case Palette8:
+        mCells.indices8[i] = quint8(index);
+        break;
+    case Palette16:
+        mCells.indices16[i] = quint16(index);
+        break;
+    case Direct:
+        mCells.tiles[i] = tile;
+        break;
+    }
+
+    return previous;
+}
+
+/**
+ * Returns the palette index for the given tile, adding it to the palette when
+ * necessary. When the palette can't grow any further, the chunk switches to
+ * the next encoding up, and -1 is returned once it has fallen back to storing
+ * plain pointers.
+ */
+int TileChunk::paletteIndex(Tile *tile)
+{
+    if (!tile)
+        return 0;
+
+    // Consecutive writes tend to use the same tile
+    Tile * const *palette = mPalette.constData();
+    if (palette[mLastIndex] == tile)
+        return mLastIndex;
+
+    const int size = mPalette.size();
+    for (int i = 1; i < size; ++i) {
+        if (palette[i] == tile) {
+            mLastIndex = i;
+            return i;
+        }
+    }
+
+    int capacity = (mEncoding == Palette8) ? MaxPalette8 : MaxPalette16;
+    if (size == capacity) {
+        compactPalette();
+
+        // Only keep using the current encoding when compacting freed up a
+        // decent amount of space, to avoid compacting on every write.
+        if (mPalette.size() > capacity * 3 / 4) {
+            if (mEncoding == Palette8) {
+                convertTo(Palette16);
+                capacity = MaxPalette16;
+            } else {
+                convertTo(Direct);
+                return -1;
+            }
+        }
+    }
+
+    mPalette.append(tile);
+    mLastIndex = mPalette.size() - 1;
+    return mLastIndex;
+}
+
+/**
+ * Drops the palette entries that are no longer used by any cell.
+ */
+void TileChunk::compactPalette()
+{
+    QVector<int> remap(mPalette.size(), -1);
+
+    for (int i = 0; i < CellCount; ++i) {
+        const int index = (mEncoding == Palette8) ? mCells.indices8[i]
+                                                  : mCells.indices16[i];
+        remap[index] = 1;
+    }
+    remap[0] = 0;
+
+    QVector<Tile*> palette;
+    palette.reserve(mPalette.size());
+    palette.append(0);
+    for (int index = 1; index < mPalette.size(); ++index) {
+        if (remap[index] != -1) {
+            remap[index] = palette.size();
+            palette.append(mPalette.at(index));
+        }
+    }
+
+    for (int i = 0; i < CellCount; ++i) {
+        if (mEncoding == Palette8)
+            mCells.indices8[i] = quint8(remap[mCells.indices8[i]]);
+        else
+            mCells.indices16[i] = quint16(remap[mCells.indices16[i]]);
+    }
+
+    mPalette = palette;
+    mLastIndex = 0;
+}
+
+void TileChunk::convertTo(Encoding encoding)
+{
+    Q_ASSERT((mEncoding == Palette8 && encoding == Palette16)
+             || (mEncoding != Direct && encoding == Direct));
+
+    if (encoding == Palette16) {
+        quint16 *indices = new quint16[CellCount];
+        for (int i = 0; i < CellCount; ++i)
+            indices[i] = mCells.indices8[i];
+
+        delete[] mCells.indices8;
+        mCells.indices16 = indices;
+    } else {
+        Tile **tiles = new Tile*[CellCount];
+        Tile * const *palette = mPalette.constData();
+        for (int i = 0; i < CellCount; ++i) {
+            const int index = (mEncoding == Palette8) ? mCells.indices8[i]
+                                                      : mCells.indices16[i];
+            tiles[i] = palette[index];
+        }
+
+        if (mEncoding == Palette8)
+            delete[] mCells.indices8;
+        else
+            delete[] mCells.indices16;
+
+        mCells.tiles = tiles;
+        mPalette.clear();
+        mLastIndex = 0;
+    }
+
+    mEncoding = encoding;
+}
@@ -0,0 +1,153 @@
+/*
+ * tilechunk.h
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILECHUNK_H
+#define TILECHUNK_H
+
+#include <QSharedData>
+#include <QVector>
+
+namespace Tiled {
+
+class Tile;
+
+/**
+ * A square block of cells. Tile layers store their tiles in chunks, which are
+ * kept in a hash indexed by chunk coordinate. This makes looking up a tile a
+ * constant time operation, while empty parts of a layer take no memory.
+ *
+ * When compact encoding is enabled, a chunk keeps a palette of the tiles it
+ * uses and stores 8-bit indices into it. Once more than 255 different tiles
+ * are used the indices are widened to 16 bits, and when even that would take
+ * more memory than storing pointers, the chunk falls back to plain tile
+ * pointers.
+ *
+ * Chunks are implicitly shared between clones of a tile layer, and only get
+ * copied when one of the layers changes a tile in them.
+ *
+ * The coordinates taken by the methods of this class are local to the chunk.
+ */
+class TileChunk : public QSharedData
+{
+public:
+    enum {
+        Bits = 5,
+        Size = 1 << Bits,
+        Mask = Size - 1,
+        CellCount = Size * Size
+    };
+
+    enum Encoding {
+        Palette8,
+        Palette16,
+        Direct
+    };
+
+    /**
+     * Constructs an empty chunk. The chunk starts out with 8-bit palette
+     * indices when \a compact is true, and with plain pointers otherwise.
+     */
+    explicit TileChunk(bool compact = true);
+
+    TileChunk(const TileChunk &other);
+
+    ~TileChunk();
+
+    /**
+     * Returns the tile at the given chunk coordinates.
+     */
+    Tile *tileAt(int x, int y) const
+    {
+        const int i = y * Size + x;
+        switch (mEncoding) {
+        case Palette8:
+            return mPalette.constData()[mCells.indices8[i]];
+        case Palette16:
+            return mPalette.constData()[mCells.indices16[i]];
+        default:
+            return mCells.tiles[i];
+        }
+    }
+
+    /**
+     * Sets the tile at the given chunk coordinates and returns the tile that
+     * was there before.
+     */
+    Tile *setTile(int x, int y, Tile *tile);
+
+    /**
+     * Returns the number of occupied cells in this chunk.
+     */
+    int count() const { return mCount; }
+
+    /**
+     * Returns whether this chunk has no tiles at all.
+     */
+    bool isEmpty() const { return mCount == 0; }
+
+    /**
+     * Returns the way the cells of this chunk are currently stored.
+     */
+    Encoding encoding() const { return mEncoding; }
+
+    /**
+     * Returns the chunk coordinate that contains the given layer coordinate.
+     * This rounds towards negative infinity, so that negative coordinates end
+     * up in the right chunk.
+     */
+    static int chunkIndex(int layerCoordinate)
+    { return layerCoordinate >> Bits; }
+
+    /**
+     * Returns the hash key used for the chunk at the given chunk coordinates.
+     */
+    static quint64 key(int chunkX, int chunkY)
+    { return (quint64(quint32(chunkY)) << 32) | quint32(chunkX); }
+
+    static int keyX(quint64 key) { return int(quint32(key)); }
+    static int keyY(quint64 key) { return int(quint32(key >> 32)); }
+
+private:
+    TileChunk &operator=(const TileChunk &);
+
+    int paletteIndex(Tile *tile);
+    void compactPalette();
+    void convertTo(Encoding encoding);
+
+    Encoding mEncoding;
+    int mCount;
+    int mLastIndex;
+
+    /**
+     * The palette used by the compact encodings. The first entry is always
+     * the empty tile, so that unset cells can be zero.
+     */
+    QVector<Tile*> mPalette;
+
+    union {
+        quint8 *indices8;
+        quint16 *indices16;
+        Tile **tiles;
+    } mCells;
+};
+
+} // namespace Tiled
+
+#endif // TILECHUNK_H
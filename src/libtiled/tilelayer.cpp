@@ -22,65 +22,243 @@
 #include "tilelayer.h"
 
 #include "map.h"
+#include "regionbuilder.h"
 #include "tile.h"
+#include "tilechunk.h"
 #include "tileset.h"
 
+#include <QDebug>
+#include <QtAlgorithms>
+
 using namespace Tiled;
 
+bool TileLayer::mCompactStorage = true;
+
+namespace {
+
+/**
+ * Collects changes to the tileset reference counts of a layer. Neighbouring
+ * cells mostly use tiles from the same tileset, so this saves most of the
+ * hash lookups during bulk operations.
+ */
+class ReferenceCounter
+{
+public:
+    ReferenceCounter(QHash<Tileset*, int> &references)
+        : mReferences(references)
+        , mTileset(0)
+        , mDelta(0)
+    {}
+
+    ~ReferenceCounter() { flush(); }
+
+    void add(Tileset *tileset) { adjust(tileset, 1); }
+    void remove(Tileset *tileset) { adjust(tileset, -1); }
+
+private:
+    void adjust(Tileset *tileset, int delta)
+    {
+        if (tileset != mTileset) {
+            flush();
+            mTileset = tileset;
+        }
+        mDelta += delta;
+    }
+
+    void flush()
+    {
+        if (mDelta == 0)
+            return;
+
+        int &count = mReferences[mTileset];
+        count += mDelta;
+        Q_ASSERT(count >= 0);
+        if (count == 0)
+            mReferences.remove(mTileset);
+        mDelta = 0;
+    }
+
+    QHash<Tileset*, int> &mReferences;
+    Tileset *mTileset;
+    int mDelta;
+};
+
+} // anonymous namespace
+
 TileLayer::TileLayer(const QString &name, int x, int y, QRect size):
     Layer(name, x, y, size),
-    mMaxTileSize(0, 0)
+    mMaxTileSize(0, 0),
+    mLoader(0)
+{
+}
+
+TileLayer::~TileLayer()
+{
+    delete mLoader;
+}
+
+void TileLayer::setLoader(TileLayerLoader *loader)
+{
+    load();
+    mLoader = loader;
+
+    // The bounds are final here, so that loading does not change them
+    mSize = mSize.united(loader->area());
+    mMaxTileSize = mMaxTileSize.expandedTo(loader->maxTileSize());
+    if (mMap)
+        mMap->adjustMaxTileSize(mMaxTileSize);
+}
+
+/**
+ * Runs and deletes the loader. The loader is taken first, so that it can
+ * place tiles without running itself again.
+ */
+void TileLayer::runLoader() const
 {
+    TileLayerLoader *loader = mLoader;
+    mLoader = 0;
+
+    // Loading only puts the tiles in place that this layer already stands for
+    TileLayer *layer = const_cast<TileLayer*>(this);
+
+    QString error;
+    if (!loader->load(layer, &error))
+        qDebug() << "Error loading tile layer" << mName << ":" << error;
+
+    delete loader;
 }
 
 QRegion TileLayer::region() const
 {
-    QRegion region;
+    load();
+
+    RegionBuilder region;
+
+    TileIterator it(this);
+    while (it.hasNext()) {
+        it.next();
+        region.addPoint(it.x() + mX, it.y() + mY);
+    }
+
+    return region.region();
+}
+
+static bool chunkLessThan(const QRect &a, const QRect &b)
+{
+    return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+}
+
+QVector<QRect> TileLayer::chunkRects() const
+{
+    load();
 
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y)
-        for (int x = mSize.left(); x <= mSize.right(); ++x)
-            if (tileAt(x, y))
-                region += QRegion(x + mX, y + mY, 1, 1);
+    QVector<QRect> rects;
+    rects.reserve(mChunks.size());
 
-    return region;
+    ChunkHash::const_iterator it = mChunks.constBegin();
+    ChunkHash::const_iterator it_end = mChunks.constEnd();
+    for (; it != it_end; ++it) {
+        rects.append(QRect(TileChunk::keyX(it.key()) * TileChunk::Size,
+                           TileChunk::keyY(it.key()) * TileChunk::Size,
+                           TileChunk::Size, TileChunk::Size));
+    }
+
+    qSort(rects.begin(), rects.end(), chunkLessThan);
+    return rects;
 }
 
 Tile *TileLayer::tileAt(int x, int y) const
 {
-    std::map<int, std::map<int, Tile *> >::const_iterator it = mTiles.find(y);
-    if (it == mTiles.end()) return NULL;
-  
-    std::map<int, Tile *>::const_iterator it2 = it->second.find(x);
-    if (it2 == it->second.end()) return NULL;
-  
-    return it2->second;
+    load();
+
+    const quint64 key = TileChunk::key(TileChunk::chunkIndex(x),
+                                       TileChunk::chunkIndex(y));
+    ChunkHash::const_iterator it = mChunks.constFind(key);
+    if (it == mChunks.constEnd())
+        return 0;
+
+    const TileChunk *chunk = it.value();
+    return chunk->tileAt(x & TileChunk::Mask, y & TileChunk::Mask);
 }
 
 void TileLayer::setTile(int x, int y, Tile *tile)
 {
+    load();
+
+    if (tile)
+        updateMaxTileSize(tile);
+
+    const quint64 key = TileChunk::key(TileChunk::chunkIndex(x),
+                                       TileChunk::chunkIndex(y));
+    const int chunkX = x & TileChunk::Mask;
+    const int chunkY = y & TileChunk::Mask;
+
     if (tile) {
-        if (tile->width() > mMaxTileSize.width()) {
-            mMaxTileSize.setWidth(tile->width());
-            if (mMap)
-                mMap->adjustMaxTileSize(mMaxTileSize);
-        }
-        if (tile->height() > mMaxTileSize.height()) {
-            mMaxTileSize.setHeight(tile->height());
-            if (mMap)
-                mMap->adjustMaxTileSize(mMaxTileSize);
+        mSize = mSize.united(QRect(x, y, 1, 1));
+
+        QSharedDataPointer<TileChunk> &chunk = mChunks[key];
+        if (!chunk) {
+            chunk = new TileChunk(mCompactStorage);
+        } else {
+            // Avoid copying a shared chunk when nothing changes
+            const TileChunk *current = chunk.constData();
+            if (current->tileAt(chunkX, chunkY) == tile)
+                return;
         }
-    }
 
-    // save a little RAM
-    if (tile) {
-      mSize = mSize.united(QRect(x, y, 1, 1));
-      
-      mTiles[y][x] = tile;
+        Tile *previous = chunk->setTile(chunkX, chunkY, tile);
+        addTilesetReference(tile->tileset());
+        if (previous)
+            removeTilesetReference(previous->tileset());
     } else {
-      mTiles[y].erase(x);
+        ChunkHash::const_iterator constIt = mChunks.constFind(key);
+        if (constIt == mChunks.constEnd())
+            return;
+
+        const TileChunk *current = constIt.value();
+        Tile *previous = current->tileAt(chunkX, chunkY);
+        if (!previous)
+            return;
+
+        removeTilesetReference(previous->tileset());
+
+        // Chunks that become empty are released, to save a little RAM
+        ChunkHash::iterator it = mChunks.find(key);
+        if (current->count() == 1)
+            mChunks.erase(it);
+        else
+            it.value()->setTile(chunkX, chunkY, 0);
+    }
+}
+
+void TileLayer::updateMaxTileSize(const Tile *tile)
+{
+    if (tile->width() > mMaxTileSize.width()) {
+        mMaxTileSize.setWidth(tile->width());
+        if (mMap)
+            mMap->adjustMaxTileSize(mMaxTileSize);
+    }
+    if (tile->height() > mMaxTileSize.height()) {
+        mMaxTileSize.setHeight(tile->height());
+        if (mMap)
+            mMap->adjustMaxTileSize(mMaxTileSize);
     }
 }
 
+void TileLayer::addTilesetReference(Tileset *tileset)
+{
+    ++mTilesetReferences[tileset];
+}
+
+void TileLayer::removeTilesetReference(Tileset *tileset)
+{
+    QHash<Tileset*, int>::iterator it = mTilesetReferences.find(tileset);
+    Q_ASSERT(it != mTilesetReferences.end());
+
+    if (--it.value() == 0)
+        mTilesetReferences.erase(it);
+}
+
 TileLayer *TileLayer::copy(const QRegion &region) const
 {
     const QRegion area = region.intersected(bounds());
@@ -94,85 +272,385 @@ TileLayer *TileLayer::copy(const QRegion &region) const
                                       bounds.intersected(mSize));
 
     foreach (const QRect &rect, area.rects())
-        for (int x = rect.left(); x <= rect.right(); ++x)
-            for (int y = rect.top(); y <= rect.bottom(); ++y)
-                copied->setTile(x - areaBounds.x() + offsetX,
-                                y - areaBounds.y() + offsetY,
-                                tileAt(x, y));
+        copied->copyRect(rect.translated(offsetX - areaBounds.x(),
+                                         offsetY - areaBounds.y()),
+                         this, rect.topLeft());
 
     return copied;
 }
 
 void TileLayer::merge(const QPoint &pos, const TileLayer *layer)
 {
-    // Determine the overlapping area
-    QRect area = QRect(pos, QSize(layer->width(), layer->height()));
+    mergeRect(QRect(pos, QSize(layer->width(), layer->height())),
+              layer, QPoint(0, 0));
+}
 
-    for (int y = area.top(); y <= area.bottom(); ++y)
-        for (int x = area.left(); x <= area.right(); ++x)
-            if (Tile *tile = layer->tileAt(x - area.left(), y - area.top()))
-                setTile(x, y, tile);
+void TileLayer::copyRect(const QRect &rect, const TileLayer *source,
+                         const QPoint &sourcePos)
+{
+    blit(rect, source, sourcePos, false);
 }
 
-QSet<Tileset*> TileLayer::usedTilesets() const
+void TileLayer::mergeRect(const QRect &rect, const TileLayer *source,
+                          const QPoint &sourcePos)
 {
-    QSet<Tileset*> tilesets;
+    blit(rect, source, sourcePos, true);
+}
 
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y) {
-        for (int x = mSize.left(); x <= mSize.right(); ++x) {
-            if (const Tile *tile = tileAt(x, y))
-                tilesets.insert(tile->tileset());
+void TileLayer::fillStamp(const QRect &rect, const TileLayer *stamp,
+                          const QPoint &origin)
+{
+    const int width = stamp->width();
+    const int height = stamp->height();
+    if (rect.isEmpty() || width <= 0 || height <= 0)
+        return;
+
+    load();
+    stamp->load();
+
+    // Read the stamp up front, its rows are repeated below
+    QVector<Tile*> stampTiles(width * height);
+    for (int y = 0; y < height; ++y)
+        stamp->readRow(0, y, width, stampTiles.data() + y * width);
+
+    int stampX = (rect.left() - origin.x()) % width;
+    int stampY = (rect.top() - origin.y()) % height;
+    if (stampX < 0)
+        stampX += width;
+    if (stampY < 0)
+        stampY += height;
+
+    QVector<Tile*> row(rect.width());
+    Tile **rowTiles = row.data();
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        Tile * const *stampRow = stampTiles.constData() + stampY * width;
+        int x = stampX;
+        for (int i = 0; i < rect.width(); ++i) {
+            rowTiles[i] = stampRow[x];
+            if (++x == width)
+                x = 0;
         }
+
+        writeRow(rect.left(), y, rect.width(), rowTiles, true);
+
+        if (++stampY == height)
+            stampY = 0;
     }
+}
 
-    return tilesets;
+void TileLayer::clearRect(const QRect &rect)
+{
+    blit(rect, 0, QPoint(), false);
 }
 
-bool TileLayer::referencesTileset(Tileset *tileset) const
+/**
+ * Copies \a rect from \a source, or clears it when no source is given. Works
+ * chunk by chunk, sharing chunks that are completely covered when the source
+ * lines up with the chunk grid.
+ */
+void TileLayer::blit(const QRect &rect, const TileLayer *source,
+                     const QPoint &sourcePos, bool skipEmpty)
 {
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y) {
-        for (int x = mSize.left(); x <= mSize.right(); ++x) {
-            const Tile *tile = tileAt(x, y);
-            if (tile && tile->tileset() == tileset)
-                return true;
+    if (rect.isEmpty())
+        return;
+
+    load();
+    if (source)
+        source->load();
+
+    if (source == this) {
+        // Avoid reading cells that were already overwritten. The clone
+        // shares the chunks, so this is cheap.
+        const TileLayer *copy = static_cast<TileLayer*>(clone());
+        blit(rect, copy, sourcePos, skipEmpty);
+        delete copy;
+        return;
+    }
+
+    const int dx = sourcePos.x() - rect.x();
+    const int dy = sourcePos.y() - rect.y();
+    const bool aligned = !skipEmpty
+            && (dx & TileChunk::Mask) == 0
+            && (dy & TileChunk::Mask) == 0;
+
+    QVector<Tile*> row(TileChunk::Size);
+    Tile **rowTiles = source ? row.data() : 0;
+
+    const int firstChunkX = TileChunk::chunkIndex(rect.left());
+    const int firstChunkY = TileChunk::chunkIndex(rect.top());
+    const int lastChunkX = TileChunk::chunkIndex(rect.right());
+    const int lastChunkY = TileChunk::chunkIndex(rect.bottom());
+
+    for (int chunkY = firstChunkY; chunkY <= lastChunkY; ++chunkY) {
+        for (int chunkX = firstChunkX; chunkX <= lastChunkX; ++chunkX) {
+            const QRect chunkRect(chunkX * TileChunk::Size,
+                                  chunkY * TileChunk::Size,
+                                  TileChunk::Size,
+                                  TileChunk::Size);
+            const QRect part = chunkRect.intersected(rect);
+
+            if (aligned && part == chunkRect) {
+                QSharedDataPointer<TileChunk> chunk;
+                if (source) {
+                    const quint64 sourceKey = TileChunk::key(
+                            TileChunk::chunkIndex(part.x() + dx),
+                            TileChunk::chunkIndex(part.y() + dy));
+                    chunk = source->mChunks.value(sourceKey);
+                }
+                replaceChunk(TileChunk::key(chunkX, chunkY), chunk);
+                continue;
+            }
+
+            for (int y = part.top(); y <= part.bottom(); ++y) {
+                if (source)
+                    source->readRow(part.x() + dx, y + dy, part.width(),
+                                    rowTiles);
+                writeRow(part.x(), y, part.width(), rowTiles, skipEmpty);
+            }
         }
     }
-    return false;
+}
+
+/**
+ * Reads \a width tiles starting at (\a x, \a y) into \a tiles.
+ */
+void TileLayer::readRow(int x, int y, int width, Tile **tiles) const
+{
+    const int chunkY = TileChunk::chunkIndex(y);
+    const int localY = y & TileChunk::Mask;
+
+    int i = 0;
+    while (i < width) {
+        const int localX = (x + i) & TileChunk::Mask;
+        const int count = qMin(width - i, TileChunk::Size - localX);
+        const quint64 key = TileChunk::key(TileChunk::chunkIndex(x + i),
+                                           chunkY);
+
+        ChunkHash::const_iterator it = mChunks.constFind(key);
+        if (it == mChunks.constEnd()) {
+            for (int j = 0; j < count; ++j)
+                tiles[i + j] = 0;
+        } else {
+            const TileChunk *chunk = it.value();
+            for (int j = 0; j < count; ++j)
+                tiles[i + j] = chunk->tileAt(localX + j, localY);
+        }
+
+        i += count;
+    }
+}
+
+/**
+ * Writes \a width tiles starting at (\a x, \a y). When \a tiles is 0, the
+ * cells are cleared. When \a skipEmpty is true, empty tiles leave the cells
+ * they would be written to untouched.
+ */
+void TileLayer::writeRow(int x, int y, int width, Tile * const *tiles,
+                         bool skipEmpty)
+{
+    const int chunkY = TileChunk::chunkIndex(y);
+    const int localY = y & TileChunk::Mask;
+
+    ReferenceCounter references(mTilesetReferences);
+    const Tile *lastTile = 0;
+    bool placed = false;
+    int placedLeft = 0;
+    int placedRight = 0;
+
+    int i = 0;
+    while (i < width) {
+        const int localX = (x + i) & TileChunk::Mask;
+        const int count = qMin(width - i, TileChunk::Size - localX);
+        const quint64 key = TileChunk::key(TileChunk::chunkIndex(x + i),
+                                           chunkY);
+        Tile * const *segment = tiles ? tiles + i : 0;
+
+        // Leave the chunk alone when nothing changes, so that a shared chunk
+        // is not copied needlessly
+        ChunkHash::const_iterator it = mChunks.constFind(key);
+        const TileChunk *current = 0;
+        if (it != mChunks.constEnd())
+            current = it.value();
+
+        int first = 0;
+        for (; first < count; ++first) {
+            const Tile *tile = segment ? segment[first] : 0;
+            if (skipEmpty && !tile)
+                continue;
+            const Tile *old = current ? current->tileAt(localX + first,
+                                                        localY) : 0;
+            if (old != tile)
+                break;
+        }
+        if (first == count) {
+            i += count;
+            continue;
+        }
+
+        QSharedDataPointer<TileChunk> &chunkPointer = mChunks[key];
+        if (!chunkPointer)
+            chunkPointer = new TileChunk(mCompactStorage);
+        TileChunk *chunk = chunkPointer;
+
+        for (int j = first; j < count; ++j) {
+            Tile *tile = segment ? segment[j] : 0;
+            if (skipEmpty && !tile)
+                continue;
+
+            Tile *old = chunk->setTile(localX + j, localY, tile);
+            if (old == tile)
+                continue;
+
+            if (tile) {
+                references.add(tile->tileset());
+                if (tile != lastTile) {
+                    updateMaxTileSize(tile);
+                    lastTile = tile;
+                }
+                if (!placed) {
+                    placed = true;
+                    placedLeft = x + i + j;
+                }
+                placedRight = x + i + j;
+            }
+            if (old)
+                references.remove(old->tileset());
+        }
+
+        // Chunks that become empty are released, like in setTile()
+        if (chunk->isEmpty())
+            mChunks.remove(key);
+
+        i += count;
+    }
+
+    if (placed)
+        mSize = mSize.united(QRect(placedLeft, y,
+                                   placedRight - placedLeft + 1, 1));
+}
+
+/**
+ * Puts \a chunk in place of the chunk at \a key, updating the tileset
+ * references and the layer size. A null chunk removes the chunk.
+ */
+void TileLayer::replaceChunk(quint64 key,
+                             const QSharedDataPointer<TileChunk> &chunk)
+{
+    ReferenceCounter references(mTilesetReferences);
+
+    ChunkHash::const_iterator it = mChunks.constFind(key);
+    if (it != mChunks.constEnd()) {
+        const TileChunk *old = it.value();
+        if (old == chunk.constData())
+            return;
+
+        for (int i = 0; i < TileChunk::CellCount; ++i) {
+            const Tile *tile = old->tileAt(i & TileChunk::Mask,
+                                           i >> TileChunk::Bits);
+            if (tile)
+                references.remove(tile->tileset());
+        }
+    }
+
+    if (!chunk) {
+        mChunks.remove(key);
+        return;
+    }
+
+    const TileChunk *added = chunk.constData();
+    const int left = TileChunk::keyX(key) * TileChunk::Size;
+    const int top = TileChunk::keyY(key) * TileChunk::Size;
+    const Tile *lastTile = 0;
+    QRect placed;
+
+    for (int i = 0; i < TileChunk::CellCount; ++i) {
+        const int x = i & TileChunk::Mask;
+        const int y = i >> TileChunk::Bits;
+        Tile *tile = added->tileAt(x, y);
+        if (!tile)
+            continue;
+
+        references.add(tile->tileset());
+        if (tile != lastTile) {
+            updateMaxTileSize(tile);
+            lastTile = tile;
+        }
+        placed = placed.united(QRect(left + x, top + y, 1, 1));
+    }
+
+    mSize = mSize.united(placed);
+    mChunks.insert(key, chunk);
+}
+
+QSet<Tileset*> TileLayer::usedTilesets() const
+{
+    // The loader knows its tilesets, so there is no need to load
+    QSet<Tileset*> tilesets = mTilesetReferences.keys().toSet();
+    if (mLoader)
+        tilesets.unite(mLoader->tilesets());
+    return tilesets;
+}
+
+bool TileLayer::referencesTileset(Tileset *tileset) const
+{
+    return mTilesetReferences.contains(tileset)
+            || (mLoader && mLoader->tilesets().contains(tileset));
 }
 
 QRegion TileLayer::tilesetReferences(Tileset *tileset) const
 {
-    QRegion region;
+    load();
 
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y)
-        for (int x = mSize.left(); x <= mSize.right(); ++x)
-            if (const Tile *tile = tileAt(x, y))
-                if (tile->tileset() == tileset)
-                    region += QRegion(x + mX, y + mY, 1, 1);
+    RegionBuilder region;
+
+    TileIterator it(this);
+    while (it.hasNext()) {
+        it.next();
+        if (it.tile()->tileset() == tileset)
+            region.addPoint(it.x() + mX, it.y() + mY);
+    }
 
-    return region;
+    return region.region();
 }
 
 void TileLayer::removeReferencesToTileset(Tileset *tileset)
 {
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y) {
-        for (int x = mSize.left(); x <= mSize.right(); ++x) {
-            const Tile *tile = tileAt(x, y);
-            if (tile && tile->tileset() == tileset)
-                setTile(x, y, NULL);
-        }
+    if (!referencesTileset(tileset))
+        return;
+
+    // Clearing tiles may release chunks, so collect the cells first
+    QVector<QPoint> cells;
+
+    TileIterator it(this);
+    while (it.hasNext()) {
+        it.next();
+        if (it.tile()->tileset() == tileset)
+            cells.append(it.pos());
     }
+
+    foreach (const QPoint &cell, cells)
+        setTile(cell.x(), cell.y(), 0);
 }
 
 void TileLayer::replaceReferencesToTileset(Tileset *oldTileset,
                                            Tileset *newTileset)
 {
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y) {
-        for (int x = mSize.left(); x <= mSize.right(); ++x) {
-            const Tile *tile = tileAt(x, y);
-            if (tile && tile->tileset() == oldTileset)
-                setTile(x, y, newTileset->tileAt(tile->id()));
-        }
+    if (!referencesTileset(oldTileset))
+        return;
+
+    QVector<QPoint> cells;
+
+    TileIterator it(this);
+    while (it.hasNext()) {
+        it.next();
+        if (it.tile()->tileset() == oldTileset)
+            cells.append(it.pos());
+    }
+
+    foreach (const QPoint &cell, cells) {
+        const Tile *tile = tileAt(cell.x(), cell.y());
+        setTile(cell.x(), cell.y(), newTileset->tileAt(tile->id()));
     }
 }
 
@@ -232,12 +710,10 @@ void TileLayer::offset(const QPoint &offset,
 
 bool TileLayer::isEmpty() const
 {
-    for (int y = mSize.top(); y <= mSize.bottom(); ++y)
-        for (int x = mSize.left(); x <= mSize.right(); ++x)
-            if (tileAt(x, y))
-                return false;
+    load();
 
-    return true;
+    // Chunks are released as soon as they become empty
+    return mChunks.isEmpty();
 }
 
 /**
@@ -253,7 +729,74 @@ Layer *TileLayer::clone() const
 TileLayer *TileLayer::initializeClone(TileLayer *clone) const
 {
     Layer::initializeClone(clone);
-    clone->mTiles = mTiles;
+
+    // The chunks are shared until either layer changes them, and a layer
+    // that is not loaded yet leaves the loading to its clone as well
+    clone->mChunks = mChunks;
+    clone->mTilesetReferences = mTilesetReferences;
+    clone->mLoader = mLoader ? mLoader->clone() : 0;
+
     clone->mMaxTileSize = mMaxTileSize;
     return clone;
 }
+
+
+TileIterator::TileIterator(const TileLayer *layer):
+    // The layer is loaded before its chunks are looked at
+    mChunk((layer->load(), layer->mChunks.constBegin())),
+    mChunkEnd(layer->mChunks.constEnd()),
+    mNextIndex(0),
+    mSeenInChunk(0),
+    mNextX(0),
+    mNextY(0),
+    mNextTile(0),
+    mX(0),
+    mY(0),
+    mTile(0)
+{
+    findNext();
+}
+
+void TileIterator::next()
+{
+    Q_ASSERT(mNextTile);
+
+    mX = mNextX;
+    mY = mNextY;
+    mTile = mNextTile;
+
+    findNext();
+}
+
+/**
+ * Looks up the occupied cell following the current one. A chunk is left as
+ * soon as all of its occupied cells have been seen.
+ */
+void TileIterator::findNext()
+{
+    mNextTile = 0;
+
+    while (mChunk != mChunkEnd) {
+        const TileChunk *chunk = mChunk.value();
+
+        while (mSeenInChunk < chunk->count()
+               && mNextIndex < TileChunk::CellCount) {
+            const int index = mNextIndex++;
+            const int x = index & TileChunk::Mask;
+            const int y = index >> TileChunk::Bits;
+
+            if (Tile *tile = chunk->tileAt(x, y)) {
+                const quint64 key = mChunk.key();
+                ++mSeenInChunk;
+                mNextTile = tile;
+                mNextX = TileChunk::keyX(key) * TileChunk::Size + x;
+                mNextY = TileChunk::keyY(key) * TileChunk::Size + y;
+                return;
+            }
+        }
+
+        ++mChunk;
+        mNextIndex = 0;
+        mSeenInChunk = 0;
+    }
+}
@@ -26,17 +26,60 @@
 
 #include "layer.h"
 
+#include <QHash>
 #include <QSet>
+#include <QSharedDataPointer>
 #include <QString>
 #include <QVector>
 
-#include <map>
-
 namespace Tiled {
 
 class Tile;
+class TileChunk;
+class TileIterator;
+class TileLayer;
 class Tileset;
 
+/**
+ * Places the tiles of a tile layer that is loaded on demand.
+ *
+ * \sa TileLayer::setLoader()
+ */
+class TILEDSHARED_EXPORT TileLayerLoader
+{
+public:
+    virtual ~TileLayerLoader() {}
+
+    /**
+     * Returns the area in which the tiles will be placed. It may be larger
+     * than the area the tiles end up covering.
+     */
+    virtual QRect area() const = 0;
+
+    /**
+     * Returns the size of the largest tile that may be placed.
+     */
+    virtual QSize maxTileSize() const = 0;
+
+    /**
+     * Returns the tilesets that the placed tiles may refer to. This may
+     * include tilesets that none of the tiles end up using.
+     */
+    virtual QSet<Tileset*> tilesets() const = 0;
+
+    /**
+     * Places the tiles on the given \a layer. Returns false and sets
+     * \a error when not all of the tiles could be placed.
+     */
+    virtual bool load(TileLayer *layer, QString *error) = 0;
+
+    /**
+     * Returns a copy of this loader, which can place the same tiles on
+     * another layer.
+     */
+    virtual TileLayerLoader *clone() const = 0;
+};
+
 /**
  * A tile layer.
  */
@@ -48,12 +91,41 @@ public:
      */
     TileLayer(const QString &name, int x, int y, QRect size);
 
+    /**
+     * Destructor.
+     */
+    ~TileLayer();
+
     /**
      * Returns the maximum tile size of this layer. Used by the layer
      * rendering code to determine the area that needs to be redrawn.
      */
     QSize maxTileSize() const { return mMaxTileSize; }
 
+    /**
+     * Makes this layer load its tiles on demand. The \a loader is run and
+     * deleted the first time the tiles of this layer are used, which
+     * includes looking up, changing, iterating or copying them. The bounds
+     * of this layer are extended by the area of the loader right away and
+     * stay the same when it runs. Until then, the maximum tile size is taken
+     * from the loader.
+     *
+     * The layer takes ownership of the loader.
+     */
+    void setLoader(TileLayerLoader *loader);
+
+    /**
+     * Returns whether the tiles of this layer are in place, which is the
+     * case unless a loader has been set that did not run yet.
+     */
+    bool isLoaded() const { return !mLoader; }
+
+    /**
+     * Runs the loader of this layer, if it has not run yet. This is done
+     * automatically when the tiles are needed.
+     */
+    void load() const { if (mLoader) runLoader(); }
+
     /**
      * Returns whether (x, y) is inside this map layer.
      */
@@ -70,8 +142,16 @@ public:
     QRegion region() const;
 
     /**
-     * Returns the tile at the given coordinates. The coordinates have to
-     * be within this layer.
+     * Returns the areas of this layer in which tiles are stored, sorted by
+     * row and then by column. Each area is a square of TileChunk::Size tiles
+     * that contains at least one tile, and there are no tiles outside of
+     * them. Useful for writing out only the non-empty parts of a layer.
+     */
+    QVector<QRect> chunkRects() const;
+
+    /**
+     * Returns the tile at the given coordinates, or 0 when there is no tile.
+     * This is a constant time operation.
      */
     Tile *tileAt(int x, int y) const;
 
@@ -100,12 +180,50 @@ public:
     void merge(const QPoint &pos, const TileLayer *layer);
 
     /**
-     * Computes and returns the set of tilesets used by this tile layer.
+     * Sets the tiles within \a rect to the tiles of \a source, starting at
+     * \a sourcePos. Empty tiles in the source clear the cells they end up
+     * on. Both the rectangle and the source position are in the local
+     * coordinates of the respective layers.
+     *
+     * Works on whole rows of chunks at a time. Chunks that are completely
+     * covered and line up with chunks of the source are shared with the
+     * source rather than copied.
+     */
+    void copyRect(const QRect &rect, const TileLayer *source,
+                  const QPoint &sourcePos);
+
+    /**
+     * Like copyRect(), but empty tiles in the \a source leave the cells they
+     * end up on untouched.
+     */
+    void mergeRect(const QRect &rect, const TileLayer *source,
+                   const QPoint &sourcePos);
+
+    /**
+     * Fills \a rect by repeating \a stamp, with the top-left tile of the
+     * stamp placed at \a origin. Empty tiles in the stamp are skipped.
+     */
+    void fillStamp(const QRect &rect, const TileLayer *stamp,
+                   const QPoint &origin);
+
+    /**
+     * Removes all tiles within \a rect.
+     */
+    void clearRect(const QRect &rect);
+
+    /**
+     * Returns the set of tilesets used by this tile layer. The layer keeps
+     * count of the tiles it uses from each tileset, so this does not need to
+     * look at the tiles. A layer that is not loaded yet asks its loader,
+     * which may also name tilesets that none of the tiles use.
      */
     QSet<Tileset*> usedTilesets() const;
 
     /**
-     * Returns whether this tile layer is referencing the given tileset.
+     * Returns whether this tile layer is referencing the given tileset. This
+     * is a constant time operation, which does not load the layer. Like
+     * usedTilesets(), it may answer true for a layer that is not loaded yet
+     * and turns out not to use the tileset.
      */
     bool referencesTileset(Tileset *tileset) const;
 
@@ -145,7 +263,8 @@ public:
                         bool wrapX, bool wrapY);*/
 
     /**
-     * Returns true if all tiles in the layer are empty.
+     * Returns true if all tiles in the layer are empty. This is a constant
+     * time operation.
      */
     bool isEmpty() const;
 
@@ -153,12 +272,118 @@ public:
 
     virtual TileLayer *asTileLayer() { return this; }
 
+    /**
+     * Sets whether tile layers store their tiles in the compact encoding,
+     * where each chunk keeps a small palette of tiles and stores 8-bit or
+     * 16-bit indices into it. This takes a fraction of the memory of storing
+     * a pointer for every cell and is enabled by default.
+     *
+     * Only affects chunks that are created after the change.
+     */
+    static void setCompactStorage(bool enabled) { mCompactStorage = enabled; }
+    static bool compactStorage() { return mCompactStorage; }
+
 protected:
     TileLayer *initializeClone(TileLayer *clone) const;
 
 private:
+    friend class TileIterator;
+
+    typedef QHash<quint64, QSharedDataPointer<TileChunk> > ChunkHash;
+
+    void runLoader() const;
+
+    void addTilesetReference(Tileset *tileset);
+    void removeTilesetReference(Tileset *tileset);
+    void updateMaxTileSize(const Tile *tile);
+
+    void readRow(int x, int y, int width, Tile **tiles) const;
+    void writeRow(int x, int y, int width, Tile * const *tiles,
+                  bool skipEmpty);
+    void replaceChunk(quint64 key, const QSharedDataPointer<TileChunk> &chunk);
+    void blit(const QRect &rect, const TileLayer *source,
+              const QPoint &sourcePos, bool skipEmpty);
+
     QSize mMaxTileSize;
-    std::map<int, std::map<int, Tile*> > mTiles;
+    ChunkHash mChunks;
+    mutable TileLayerLoader *mLoader;
+
+    /**
+     * The number of cells referring to each of the used tilesets.
+     */
+    QHash<Tileset*, int> mTilesetReferences;
+
+    static bool mCompactStorage;
+};
+
+/**
+ * Iterates over the occupied cells of a tile layer, skipping empty space. The
+ * cost of a full iteration scales with the number of occupied chunks rather
+ * than with the bounds of the layer.
+ *
+ * Cells are visited chunk by chunk, so they come in no particular order. The
+ * layer must not be modified while it is being iterated.
+ *
+ * \code
+ * TileIterator it(tileLayer);
+ * while (it.hasNext()) {
+ *     it.next();
+ *     doSomething(it.x(), it.y(), it.tile());
+ * }
+ * \endcode
+ */
+class TILEDSHARED_EXPORT TileIterator
+{
+public:
+    /**
+     * Constructs an iterator positioned before the first occupied cell of
+     * the given \a layer.
+     */
+    TileIterator(const TileLayer *layer);
+
+    /**
+     * Returns whether there is another occupied cell to visit.
+     */
+    bool hasNext() const { return mNextTile != 0; }
+
+    /**
+     * Advances the iterator to the next occupied cell.
+     */
+    void next();
+
+    /**
+     * Returns the x coordinate of the current cell, in layer coordinates.
+     */
+    int x() const { return mX; }
+
+    /**
+     * Returns the y coordinate of the current cell, in layer coordinates.
+     */
+    int y() const { return mY; }
+
+    QPoint pos() const { return QPoint(mX, mY); }
+
+    /**
+     * Returns the tile of the current cell. Never 0 after next() has been
+     * called.
+     */
+    Tile *tile() const { return mTile; }
+
+private:
+    void findNext();
+
+    TileLayer::ChunkHash::const_iterator mChunk;
+    TileLayer::ChunkHash::const_iterator mChunkEnd;
+    int mNextIndex;
+    int mSeenInChunk;
+
+    int mNextX;
+    int mNextY;
+    Tile *mNextTile;
+
+    int mX;
+    int mY;
+    Tile *mTile;
 };
 
 } // namespace Tiled
@@ -22,7 +22,7 @@
 #include "tileset.h"
 #include "tile.h"
 
-#include <QBitmap>
+#include <QImage>
 
 using namespace Tiled;
 
@@ -31,56 +31,138 @@ Tileset::~Tileset()
     qDeleteAll(mTiles);
 }
 
+Tileset *Tileset::clone() const
+{
+    Tileset *c = new Tileset(mName, mTileWidth, mTileHeight,
+                             mTileSpacing, mMargin);
+    c->mFileName = mFileName;
+    c->mImageSource = mImageSource;
+    c->mTransparentColor = mTransparentColor;
+    c->mImageWidth = mImageWidth;
+    c->mImageHeight = mImageHeight;
+    c->mColumnCount = mColumnCount;
+    c->mPlaceholder = mPlaceholder;
+
+    foreach (const Tile *tile, mTiles) {
+        Tile *tileClone = new Tile(tile->atlas(), tile->atlasRect(),
+                                   tile->id(), c);
+        tileClone->setProperties(tile->properties());
+        c->mTiles.append(tileClone);
+    }
+
+    return c;
+}
+
 Tile *Tileset::tileAt(int id) const
 {
     return (id < mTiles.size()) ? mTiles.at(id) : 0;
 }
 
 bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
+{
+    return loadFromAtlasImage(atlasImage(image, mTransparentColor), fileName);
+}
+
+bool Tileset::loadFromAtlasImage(const QImage &atlasImage,
+                                 const QString &fileName)
 {
     Q_ASSERT(mTileWidth > 0 && mTileHeight > 0);
 
-    if (image.isNull())
+    if (atlasImage.isNull())
         return false;
 
-    const int stopWidth = image.width() - mTileWidth;
-    const int stopHeight = image.height() - mTileHeight;
+    const QPixmap atlas = QPixmap::fromImage(atlasImage);
+    setTileImages(atlasImage.size(), atlas, true);
+    mImageSource = fileName;
+    return true;
+}
+
+bool Tileset::loadPlaceholder(const QSize &imageSize, const QString &fileName)
+{
+    Q_ASSERT(mTileWidth > 0 && mTileHeight > 0);
+
+    if (imageSize.isEmpty())
+        return false;
+
+    QPixmap placeholder(mTileWidth, mTileHeight);
+    placeholder.fill(Qt::transparent);
+    setTileImages(imageSize, placeholder, false);
+    mImageSource = fileName;
+    return true;
+}
+
+QImage Tileset::atlasImage(const QImage &image,
+                           const QColor &transparentColor)
+{
+    if (image.isNull())
+        return image;
+
+    if (!transparentColor.isValid()) {
+        if (!image.hasAlphaChannel())
+            return image;
+        return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    // Opaque pixels look the same when premultiplied, so the transparent
+    // color can be looked for after converting
+    QImage atlasImage =
+            image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const QRgb transparent = transparentColor.rgb();
+    for (int y = 0; y < atlasImage.height(); ++y) {
+        QRgb *pixel = reinterpret_cast<QRgb*>(atlasImage.scanLine(y));
+        const QRgb *end = pixel + atlasImage.width();
+        for (; pixel != end; ++pixel)
+            if (*pixel == transparent)
+                *pixel = 0;
+    }
+
+    return atlasImage;
+}
+
+/**
+ * Lays out the tiles for a tileset image of the given \a imageSize. When
+ * \a isAtlas is true, the tiles show their part of the \a image. Otherwise
+ * they all show the whole \a image, which is a placeholder.
+ */
+void Tileset::setTileImages(const QSize &imageSize, const QPixmap &image,
+                            bool isAtlas)
+{
+    const int stopWidth = imageSize.width() - mTileWidth;
+    const int stopHeight = imageSize.height() - mTileHeight;
 
     int oldTilesetSize = mTiles.size();
     int tileNum = 0;
 
     for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
         for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
-            const QImage tileImage = image.copy(x, y, mTileWidth, mTileHeight);
-            QPixmap tilePixmap = QPixmap::fromImage(tileImage);
-
-            if (mTransparentColor.isValid()) {
-                const QImage mask =
-                        tileImage.createMaskFromColor(mTransparentColor.rgb());
-                tilePixmap.setMask(QBitmap::fromImage(mask));
-            }
+            const QRect imageRect = isAtlas
+                    ? QRect(x, y, mTileWidth, mTileHeight)
+                    : image.rect();
 
             if (tileNum < oldTilesetSize) {
-                mTiles.at(tileNum)->setImage(tilePixmap);
+                mTiles.at(tileNum)->setImage(image, imageRect);
             } else {
-                mTiles.append(new Tile(tilePixmap, tileNum, this));
+                mTiles.append(new Tile(image, imageRect, tileNum, this));
             }
             ++tileNum;
         }
     }
 
     // Blank out any remaining tiles to avoid confusion
-    while (tileNum < oldTilesetSize) {
-        QPixmap tilePixmap = QPixmap(mTileWidth, mTileHeight);
-        tilePixmap.fill();
-        mTiles.at(tileNum)->setImage(tilePixmap);
-        ++tileNum;
+    if (tileNum < oldTilesetSize) {
+        QPixmap blank(mTileWidth, mTileHeight);
+        blank.fill();
+
+        while (tileNum < oldTilesetSize) {
+            mTiles.at(tileNum)->setImage(blank);
+            ++tileNum;
+        }
     }
 
-    mImageWidth = image.width();
-    mImageHeight = image.height();
-    mColumnCount = (image.width() - mMargin * 2 + mTileSpacing)
+    mImageWidth = imageSize.width();
+    mImageHeight = imageSize.height();
+    mColumnCount = (imageSize.width() - mMargin * 2 + mTileSpacing)
                    / (mTileWidth + mTileSpacing);
-    mImageSource = fileName;
-    return true;
+    mPlaceholder = !isAtlas;
 }
@@ -29,6 +29,8 @@
 #include <QString>
 
 class QImage;
+class QPixmap;
+class QSize;
 
 namespace Tiled {
 
@@ -61,7 +63,8 @@ public:
         mMargin(margin),
         mImageWidth(0),
         mImageHeight(0),
-        mColumnCount(0)
+        mColumnCount(0),
+        mPlaceholder(false)
     {
     }
 
@@ -70,6 +73,12 @@ public:
      */
     ~Tileset();
 
+    /**
+     * Returns a copy of this tileset. The tiles of the copy share their
+     * images with the tiles of this tileset.
+     */
+    Tileset *clone() const;
+
     /**
      * Returns the name of this tileset.
      */
@@ -148,8 +157,8 @@ public:
     QColor transparentColor() const { return mTransparentColor; }
 
     /**
-     * Sets the transparent color. Pixels with this color will be masked out
-     * when loadFromImage() is called.
+     * Sets the transparent color. Pixels with this color will be made
+     * transparent when loadFromImage() is called.
      */
     void setTransparentColor(const QColor &c) { mTransparentColor = c; }
 
@@ -169,6 +178,37 @@ public:
      */
     bool loadFromImage(const QImage &image, const QString &fileName);
 
+    /**
+     * Like loadFromImage(), but takes an image that was already prepared with
+     * atlasImage(), which makes this a cheap operation.
+     */
+    bool loadFromAtlasImage(const QImage &atlasImage,
+                            const QString &fileName);
+
+    /**
+     * Sets up the tiles for a tileset image of the given \a imageSize, without
+     * having the image yet. The tiles get their final size, but show a
+     * transparent placeholder until the image is loaded with loadFromImage()
+     * or loadFromAtlasImage().
+     */
+    bool loadPlaceholder(const QSize &imageSize, const QString &fileName);
+
+    /**
+     * Returns whether the tiles show a placeholder instead of the tileset
+     * image.
+     */
+    bool hasPlaceholderTiles() const { return mPlaceholder; }
+
+    /**
+     * Returns the \a image with the pixels of the \a transparentColor made
+     * transparent, as the tiles of a tileset are taken from it. Images with
+     * transparency are converted to premultiplied ARGB32, which is the
+     * fastest format to draw. Unlike loading the tileset, this can be done
+     * in any thread.
+     */
+    static QImage atlasImage(const QImage &image,
+                             const QColor &transparentColor);
+
     /**
      * Returns the file name of the external image that contains the tiles in
      * this tileset. Is an empty string when this tileset doesn't have a
@@ -177,6 +217,9 @@ public:
     const QString &imageSource() const { return mImageSource; }
 
 private:
+    void setTileImages(const QSize &imageSize, const QPixmap &image,
+                       bool isAtlas);
+
     QString mName;
     QString mFileName;
     QString mImageSource;
@@ -188,6 +231,7 @@ private:
     int mImageWidth;
     int mImageHeight;
     int mColumnCount;
+    bool mPlaceholder;
     QList<Tile*> mTiles;
 };
 
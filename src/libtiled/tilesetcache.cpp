@@ -0,0 +1,442 @@
+/*
+ * tilesetcache.cpp
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilesetcache.h"
+
+#include "mapreader.h"
+#include "tileset.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+
+#include <cstring>
+
+using namespace Tiled;
+
+static void clearGlobalTilesetCache();
+
+// The cached tilesets hold pixmaps, which need to be gone before the
+// application is
+Q_GLOBAL_STATIC_WITH_INITIALIZER(TilesetCache, globalTilesetCache,
+                                 qAddPostRoutine(clearGlobalTilesetCache))
+
+static void clearGlobalTilesetCache()
+{
+    globalTilesetCache()->clear();
+}
+
+static const qint64 DefaultMemoryBudget = 256 * 1024 * 1024;
+static const qint64 DefaultDiskCacheBudget = Q_INT64_C(1024) * 1024 * 1024;
+
+static const char DiskCacheMagic[8] = { 'M', 'I', 'L', 'D', 'A', 'T', 'L', '1' };
+static const QImage::Format DiskCacheFormat = QImage::Format_ARGB32_Premultiplied;
+
+/**
+ * The header of an image in the disk cache. The pixels follow right after
+ * it. Since the cache is local to the machine, native byte order is used.
+ */
+struct DiskCacheHeader
+{
+    char magic[8];
+    qint64 sourceSize;
+    qint64 sourceModified;      // In seconds since the epoch
+    qint32 width;
+    qint32 height;
+    qint32 bytesPerLine;
+    qint32 format;
+};
+
+/**
+ * Returns the cost of \a bytes in the kilobytes used by the QCache, rounding
+ * up so that every entry counts.
+ */
+static int costOf(qint64 bytes)
+{
+    return int(qMax(qint64(1), (bytes + 1023) / 1024));
+}
+
+TilesetCache::Entry::~Entry()
+{
+    delete tileset;
+}
+
+/**
+ * Returns the path of the disk cache entry for the file with the canonical
+ * path \a key.
+ */
+static QString diskCacheFilePath(const QString &directory, const QString &key)
+{
+    const QByteArray hash = QCryptographicHash::hash(key.toUtf8(),
+                                                     QCryptographicHash::Sha1);
+    return QDir(directory).filePath(QString::fromLatin1(hash.toHex())
+                                    + QLatin1String(".atlas"));
+}
+
+/**
+ * Reads the image stored in the disk cache entry at \a path, provided it was
+ * made for a source file with the given \a lastModified time and \a size.
+ * Returns a null image otherwise.
+ */
+static QImage readDiskCacheImage(const QString &path,
+                                 const QDateTime &lastModified, qint64 size)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QImage();
+
+    const qint64 fileSize = file.size();
+    if (fileSize < qint64(sizeof(DiskCacheHeader)))
+        return QImage();
+
+    uchar *data = file.map(0, fileSize);
+    if (!data)
+        return QImage();
+
+    DiskCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    QImage image;
+    if (std::memcmp(header.magic, DiskCacheMagic, sizeof(DiskCacheMagic)) == 0
+            && header.sourceSize == size
+            && header.sourceModified == qint64(lastModified.toTime_t())
+            && header.format == DiskCacheFormat
+            && header.width > 0 && header.height > 0
+            && header.bytesPerLine >= header.width * 4
+            && fileSize == qint64(sizeof(header))
+                           + qint64(header.bytesPerLine) * header.height) {
+        // The image needs its own copy of the pixels, since it may live on
+        // after the file is unmapped
+        image = QImage(data + sizeof(header), header.width, header.height,
+                       header.bytesPerLine, DiskCacheFormat).copy();
+    }
+
+    file.unmap(data);
+    return image;
+}
+
+/**
+ * Removes the oldest entries from the disk cache in \a directory until the
+ * rest fits in the \a budget.
+ */
+static void trimDiskCache(const QString &directory, qint64 budget)
+{
+    const QStringList filters(QLatin1String("*.atlas"));
+    const QFileInfoList entries =
+            QDir(directory).entryInfoList(filters, QDir::Files, QDir::Time);
+
+    qint64 total = 0;
+    foreach (const QFileInfo &entry, entries) {
+        total += entry.size();
+        if (total > budget)
+            QFile::remove(entry.filePath());
+    }
+}
+
+/**
+ * Stores the \a image, which has to be in the disk cache format, at \a path.
+ * It is written to a temporary file first, so that other processes never
+ * see a partial entry.
+ */
+static void writeDiskCacheImage(const QString &path, const QImage &image,
+                                const QDateTime &lastModified, qint64 size)
+{
+    QTemporaryFile file(path + QLatin1String(".XXXXXX"));
+    if (!file.open())
+        return;
+
+    DiskCacheHeader header;
+    std::memcpy(header.magic, DiskCacheMagic, sizeof(DiskCacheMagic));
+    header.sourceSize = size;
+    header.sourceModified = lastModified.toTime_t();
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = image.format();
+
+    const qint64 pixelBytes = qint64(image.bytesPerLine()) * image.height();
+    if (file.write(reinterpret_cast<const char*>(&header), sizeof(header))
+                != qint64(sizeof(header))
+            || file.write(reinterpret_cast<const char*>(image.bits()),
+                          pixelBytes) != pixelBytes) {
+        qDebug() << "Error writing image cache file" << file.fileName();
+        return;
+    }
+
+    file.close();
+    QFile::remove(path);
+    if (file.rename(path))
+        file.setAutoRemove(false);
+}
+
+TilesetCache::TilesetCache():
+    mDiskCacheBudget(DefaultDiskCacheBudget),
+    mHitCount(0),
+    mMissCount(0),
+    mDiskHitCount(0)
+{
+    mEntries.setMaxCost(costOf(DefaultMemoryBudget));
+}
+
+TilesetCache::~TilesetCache()
+{
+}
+
+TilesetCache *TilesetCache::instance()
+{
+    return globalTilesetCache();
+}
+
+QImage TilesetCache::image(const QString &fileName)
+{
+    return readImage(fileName, false);
+}
+
+QImage TilesetCache::reloadImage(const QString &fileName)
+{
+    return readImage(fileName, true);
+}
+
+/**
+ * Returns the image stored in the file \a fileName. Unless \a reload is
+ * set, the image is taken from the memory or disk cache when it's there.
+ */
+QImage TilesetCache::readImage(const QString &fileName, bool reload)
+{
+    const QFileInfo fileInfo(fileName);
+    const QString key = fileInfo.canonicalFilePath();
+    if (key.isEmpty())
+        return QImage(fileName);
+
+    const QDateTime lastModified = fileInfo.lastModified();
+    const qint64 size = fileInfo.size();
+
+    QImage image;
+    if (!reload) {
+        if (find(key, lastModified, size, false, &image, 0))
+            return image;
+    } else {
+        QMutexLocker locker(&mMutex);
+        ++mMissCount;
+    }
+
+    const QString directory = diskCacheDirectory();
+
+    // Reading and decoding is done without holding the lock, so that other
+    // threads can use the cache in the meantime
+    if (!directory.isEmpty()) {
+        const QString path = diskCacheFilePath(directory, key);
+        if (!reload)
+            image = readDiskCacheImage(path, lastModified, size);
+
+        if (!image.isNull()) {
+            QMutexLocker locker(&mMutex);
+            ++mDiskHitCount;
+        } else {
+            image = QImage(fileName);
+            if (!image.isNull()) {
+                image = image.convertToFormat(DiskCacheFormat);
+                writeDiskCacheImage(path, image, lastModified, size);
+                trimDiskCache(directory, diskCacheBudget());
+            }
+        }
+    } else {
+        image = QImage(fileName);
+    }
+
+    if (!image.isNull()) {
+        Entry *entry = new Entry;
+        entry->lastModified = lastModified;
+        entry->size = size;
+        entry->image = image;
+        insert(key, entry, image.byteCount());
+    }
+
+    return image;
+}
+
+Tileset *TilesetCache::tileset(const QString &fileName, QString *error)
+{
+    const QFileInfo fileInfo(fileName);
+    const QString key = fileInfo.canonicalFilePath();
+    const QDateTime lastModified = fileInfo.lastModified();
+    const qint64 size = fileInfo.size();
+
+    Tileset *tileset = 0;
+    if (!key.isEmpty() && find(key, lastModified, size, true, 0, &tileset)) {
+        tileset->setFileName(fileName);
+        return tileset;
+    }
+
+    MapReader reader;
+    tileset = reader.readTileset(fileName);
+    if (!tileset) {
+        *error = reader.errorString();
+        return 0;
+    }
+
+    if (!key.isEmpty()) {
+        Entry *entry = new Entry;
+        entry->lastModified = lastModified;
+        entry->size = size;
+        entry->tileset = tileset->clone();
+
+        if (!tileset->imageSource().isEmpty()) {
+            const QFileInfo imageInfo(tileset->imageSource());
+            entry->imageSource = tileset->imageSource();
+            entry->imageLastModified = imageInfo.lastModified();
+            entry->imageSize = imageInfo.size();
+        }
+
+        insert(key, entry, qint64(tileset->tileCount())
+               * tileset->tileWidth() * tileset->tileHeight() * 4);
+    }
+
+    return tileset;
+}
+
+void TilesetCache::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.setMaxCost(costOf(bytes));
+}
+
+qint64 TilesetCache::memoryBudget() const
+{
+    QMutexLocker locker(&mMutex);
+    return qint64(mEntries.maxCost()) * 1024;
+}
+
+qint64 TilesetCache::memoryUsage() const
+{
+    QMutexLocker locker(&mMutex);
+    return qint64(mEntries.totalCost()) * 1024;
+}
+
+void TilesetCache::setDiskCacheDirectory(const QString &path)
+{
+    if (!path.isEmpty() && !QDir().mkpath(path))
+        qDebug() << "Error creating image cache directory" << path;
+
+    QMutexLocker locker(&mMutex);
+    mDiskCacheDirectory = path;
+}
+
+QString TilesetCache::diskCacheDirectory() const
+{
+    QMutexLocker locker(&mMutex);
+    return mDiskCacheDirectory;
+}
+
+void TilesetCache::setDiskCacheBudget(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    mDiskCacheBudget = bytes;
+}
+
+qint64 TilesetCache::diskCacheBudget() const
+{
+    QMutexLocker locker(&mMutex);
+    return mDiskCacheBudget;
+}
+
+int TilesetCache::hitCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mHitCount;
+}
+
+int TilesetCache::missCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMissCount;
+}
+
+int TilesetCache::diskHitCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mDiskHitCount;
+}
+
+void TilesetCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.clear();
+    mHitCount = 0;
+    mMissCount = 0;
+    mDiskHitCount = 0;
+}
+
+/**
+ * Looks up the entry for the file with the canonical path \a key, dropping it
+ * when the file has changed since. On a hit, either a copy of the \a image or
+ * of the \a tileset is returned, depending on \a wantTileset. The tileset is
+ * copied while the entry is known to be alive.
+ */
+bool TilesetCache::find(const QString &key, const QDateTime &lastModified,
+                        qint64 size, bool wantTileset,
+                        QImage *image, Tileset **tileset)
+{
+    QMutexLocker locker(&mMutex);
+
+    Entry *entry = mEntries.object(key);
+    if (entry && (entry->lastModified != lastModified || entry->size != size)) {
+        mEntries.remove(key);
+        entry = 0;
+    }
+
+    // A tileset is out of date as well when its image changed
+    if (entry && !entry->imageSource.isEmpty()) {
+        const QFileInfo imageInfo(entry->imageSource);
+        if (imageInfo.lastModified() != entry->imageLastModified
+            || imageInfo.size() != entry->imageSize) {
+            mEntries.remove(key);
+            entry = 0;
+        }
+    }
+
+    if (entry && wantTileset && entry->tileset) {
+        *tileset = entry->tileset->clone();
+    } else if (entry && !wantTileset && !entry->image.isNull()) {
+        *image = entry->image;
+    } else {
+        ++mMissCount;
+        return false;
+    }
+
+    ++mHitCount;
+    return true;
+}
+
+/**
+ * Adds the \a entry for the file with the canonical path \a key, replacing
+ * any existing one. An entry that doesn't fit in the budget is deleted right
+ * away.
+ */
+void TilesetCache::insert(const QString &key, Entry *entry, qint64 cost)
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.insert(key, entry, costOf(cost));
+}
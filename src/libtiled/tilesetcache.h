@@ -0,0 +1,173 @@
+/*
+ * tilesetcache.h
+ * Copyright 2010, Ben Wilhelm <zorba-mild@pavlovian.net>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILESETCACHE_H
+#define TILESETCACHE_H
+
+#include "tiled_global.h"
+
+#include <QCache>
+#include <QDateTime>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+namespace Tiled {
+
+class Tileset;
+
+/**
+ * A cache of decoded tileset images and parsed external tilesets, shared by
+ * everything in the process that reads maps. It saves decoding the same
+ * images and parsing the same tileset files over and over again when many
+ * maps are read.
+ *
+ * Files are identified by their canonical path, and an entry is only used
+ * while the modification time and size of its file remain unchanged. The
+ * least recently used entries are dropped once the cache grows beyond its
+ * memory budget.
+ *
+ * Optionally, decoded images are also kept on disk between runs, see
+ * setDiskCacheDirectory().
+ *
+ * All methods may be called from any thread. Since tilesets hold pixmaps,
+ * the usual restrictions on using those outside of the GUI thread apply to
+ * the tilesets returned by the cache.
+ */
+class TILEDSHARED_EXPORT TilesetCache
+{
+public:
+    TilesetCache();
+    ~TilesetCache();
+
+    /**
+     * Returns the cache used by MapReader.
+     */
+    static TilesetCache *instance();
+
+    /**
+     * Returns the image stored in the file \a fileName, decoding it only when
+     * it isn't in the cache yet. Returns a null image when the file can't be
+     * read.
+     */
+    QImage image(const QString &fileName);
+
+    /**
+     * Like image(), but always decodes the file and replaces what the cache
+     * holds for it, both in memory and on disk. To be used when the file is
+     * known to have changed, since the cache tells files apart only by their
+     * size and a modification time with a resolution of one second.
+     */
+    QImage reloadImage(const QString &fileName);
+
+    /**
+     * Returns a new copy of the TSX tileset stored in the file \a fileName,
+     * reading the file only when it isn't in the cache yet. The caller takes
+     * ownership of the returned tileset. A cached tileset is also read again
+     * when its image file changed.
+     *
+     * Returns 0 and sets \a error when the tileset can't be read.
+     */
+    Tileset *tileset(const QString &fileName, QString *error);
+
+    /**
+     * Sets the amount of memory in bytes the cached images and tilesets may
+     * take. Entries are dropped as needed to stay within it, starting with
+     * the least recently used ones. Files that are larger than the whole
+     * budget are never cached.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+
+    /**
+     * Returns the amount of memory in bytes taken by the cached entries.
+     */
+    qint64 memoryUsage() const;
+
+    /**
+     * Sets the directory in which decoded images are stored, so that later
+     * runs don't need to decode them again. The images are stored as raw
+     * premultiplied ARGB32 pixels, which is also the format image() returns
+     * them in while the disk cache is used. An entry is replaced when its
+     * file changes, or when the image is read with reloadImage().
+     *
+     * An empty \a path, which is the default, disables the disk cache.
+     */
+    void setDiskCacheDirectory(const QString &path);
+    QString diskCacheDirectory() const;
+
+    /**
+     * Sets the amount of disk space in bytes the stored images may take.
+     * The oldest ones are removed as needed to stay within it.
+     */
+    void setDiskCacheBudget(qint64 bytes);
+    qint64 diskCacheBudget() const;
+
+    /**
+     * Returns how many requests were answered from the cache, and how many
+     * needed the file to be read. Of those, diskHitCount() returns how many
+     * could be read from the disk cache instead of being decoded.
+     */
+    int hitCount() const;
+    int missCount() const;
+    int diskHitCount() const;
+
+    /**
+     * Drops all entries and resets the hit and miss counts. The disk cache
+     * is left alone.
+     */
+    void clear();
+
+private:
+    Q_DISABLE_COPY(TilesetCache)
+
+    struct Entry
+    {
+        Entry() : size(0), tileset(0), imageSize(0) {}
+        ~Entry();
+
+        QDateTime lastModified;
+        qint64 size;
+        QImage image;
+        Tileset *tileset;
+
+        // The image file of the tileset, which is checked as well
+        QString imageSource;
+        QDateTime imageLastModified;
+        qint64 imageSize;
+    };
+
+    QImage readImage(const QString &fileName, bool reload);
+    bool find(const QString &key, const QDateTime &lastModified, qint64 size,
+              bool wantTileset, QImage *image, Tileset **tileset);
+    void insert(const QString &key, Entry *entry, qint64 cost);
+
+    mutable QMutex mMutex;
+    QCache<QString, Entry> mEntries;    // Costs are in kilobytes
+    QString mDiskCacheDirectory;
+    qint64 mDiskCacheBudget;
+    int mHitCount;
+    int mMissCount;
+    int mDiskHitCount;
+};
+
+} // namespace Tiled
+
+#endif // TILESETCACHE_H
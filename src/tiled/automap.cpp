@@ -27,6 +27,7 @@
 #include "layermodel.h"
 #include "map.h"
 #include "mapdocument.h"
+#include "regionbuilder.h"
 #include "tile.h"
 #include "tilelayer.h"
 #include "tilepainter.h"
@@ -234,38 +235,45 @@ bool AutoMapper::isPartOfExistingRule(QPoint p) const
 
 QRegion AutoMapper::createRule(int x, int y) const
 {
-    QRegion ret(x, y, 1, 1);
+    // Only cells holding the matched tile are visited, which all lie within
+    // the bounds of the rule regions layer
+    const QRect area = mLayerRuleRegions->bounds()
+            .translated(-mLayerRuleRegions->x(), -mLayerRuleRegions->y());
+    QVector<quint8> visited(area.width() * area.height());
+
+    RegionBuilder ret;
     QList<QPoint> addPoints;
     Tile *match = mLayerRuleRegions->tileAt(x, y);
     addPoints.append(QPoint(x, y));
+    visited[(y - area.top()) * area.width() + (x - area.left())] = 1;
 
     while (!addPoints.empty()) {
         const QPoint current = addPoints.takeFirst();
-        x = current.x();
-        y = current.y();
-        if (mLayerRuleRegions->tileAt(x - 1, y) == match
-                && !ret.contains(QPoint(x - 1, y))) {
-            ret += QRegion(x - 1, y, 1, 1);
-            addPoints.append(QPoint(x - 1, y));
-        }
-        if (mLayerRuleRegions->tileAt(x + 1, y) == match
-                && !ret.contains(QPoint(x + 1, y))) {
-            ret += QRegion(x + 1, y, 1, 1);
-            addPoints.append(QPoint(x + 1, y));
-        }
-        if (mLayerRuleRegions->tileAt(x, y - 1) == match
-                && !ret.contains(QPoint(x, y - 1))) {
-            ret += QRegion(x, y - 1, 1, 1);
-            addPoints.append(QPoint(x, y - 1));
-        }
-        if (mLayerRuleRegions->tileAt(x, y + 1) == match
-                && !ret.contains(QPoint(x, y + 1))) {
-            ret += QRegion(x, y + 1, 1, 1);
-            addPoints.append(QPoint(x, y + 1));
+        ret.addPoint(current.x(), current.y());
+
+        const QPoint neighbours[4] = {
+            QPoint(current.x() - 1, current.y()),
+            QPoint(current.x() + 1, current.y()),
+            QPoint(current.x(), current.y() - 1),
+            QPoint(current.x(), current.y() + 1)
+        };
+
+        for (int i = 0; i < 4; ++i) {
+            const QPoint &p = neighbours[i];
+            if (mLayerRuleRegions->tileAt(p) != match)
+                continue;
+
+            quint8 &seen =
+                    visited[(p.y() - area.top()) * area.width()
+                            + (p.x() - area.left())];
+            if (!seen) {
+                seen = 1;
+                addPoints.append(p);
+            }
         }
     }
 
-    return ret;
+    return ret.region();
 }
 
 bool AutoMapper::setupRuleList()
@@ -345,12 +353,7 @@ void AutoMapper::copyRegion(TileLayer *srcLayer, int srcX, int srcY,
                             TileLayer *dstLayer, int dstX, int dstY)
 {
     TilePainter tp(mMapDocument, dstLayer);
-    for (int x = 0; x < width; x++) {
-        for (int y = 0; y < height; y++) {
-            if (Tile *t = srcLayer->tileAt(srcX + x, srcY + y))
-                tp.setTile(dstX + x, dstY + y, t);
-        }
-    }
+    tp.drawTiles(dstX, dstY, srcLayer, QRect(srcX, srcY, width, height));
 }
 
 void AutoMapper::copyMapRegion(const QRegion &region, QPoint offset,
@@ -624,7 +627,12 @@ AutomaticMapping::AutomaticMapping(AutoMapper *autoMapper)
         const int layerindex = map->indexOfLayer(layerName);
         mLayersBefore << map->layerAt(layerindex)->clone();
     }
+
+    // Let the views catch up once the whole rule file has been applied
+    mMapDocument->beginChanges();
     autoMapper->autoMap();
+    mMapDocument->endChanges();
+
     foreach (const QString &layerName, autoMapper->getTouchedLayers()) {
         const int layerindex = map->indexOfLayer(layerName);
         // layerindex exists, because AutoMapper is still alive, dont check
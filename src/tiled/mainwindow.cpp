@@ -43,6 +43,7 @@
 #include "map.h"
 #include "mapdocument.h"
 #include "mapdocumentactionhandler.h"
+#include "maprenderer.h"
 #include "mapscene.h"
 #include "newmapdialog.h"
 #include "newtilesetdialog.h"
@@ -68,6 +69,7 @@
 
 #include <QCloseEvent>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QScrollBar>
 #include <QSessionManager>
@@ -187,6 +189,7 @@ MainWindow::MainWindow(QWidget *parent, Qt::WFlags flags)
 
     connect(mUi->actionNew, SIGNAL(triggered()), SLOT(newMap()));
     connect(mUi->actionOpen, SIGNAL(triggered()), SLOT(openFile()));
+    connect(mUi->actionOpenRegion, SIGNAL(triggered()), SLOT(openRegion()));
     connect(mUi->actionClearRecentFiles, SIGNAL(triggered()),
             SLOT(clearRecentFiles()));
     connect(mUi->actionSave, SIGNAL(triggered()), SLOT(saveFile()));
@@ -301,6 +304,8 @@ MainWindow::MainWindow(QWidget *parent, Qt::WFlags flags)
     mUi->menuView->addAction(undoDock->toggleViewAction());
 
     connect(mClipboardManager, SIGNAL(hasMapChanged()), SLOT(updateActions()));
+    connect(TilesetManager::instance(), SIGNAL(tilesetLoadFailed(Tileset*)),
+            SLOT(tilesetLoadFailed(Tileset*)));
 
     updateActions();
     readSettings();
@@ -397,7 +402,8 @@ void MainWindow::newMap()
 }
 
 bool MainWindow::openFile(const QString &fileName,
-                          MapReaderInterface *mapReader)
+                          MapReaderInterface *mapReader,
+                          const QRect &region)
 {
     if (fileName.isEmpty() || !confirmSave())
         return false;
@@ -421,6 +427,8 @@ bool MainWindow::openFile(const QString &fileName,
     if (!mapReader)
         mapReader = &tmxMapReader;
 
+    tmxMapReader.setRegion(region);
+
     Map *map = mapReader->read(fileName);
     if (!map) {
         QMessageBox::critical(this, tr("Error Opening Map"),
@@ -428,8 +436,14 @@ bool MainWindow::openFile(const QString &fileName,
         return false;
     }
 
-    setMapDocument(new MapDocument(map, fileName));
-    mUi->mapView->centerOn(0, 0);
+    if (region.isNull()) {
+        setMapDocument(new MapDocument(map, fileName));
+        mUi->mapView->centerOn(0, 0);
+    } else {
+        setMapDocument(new MapDocument(map));
+        const MapRenderer *renderer = mMapDocument->renderer();
+        mUi->mapView->centerOn(renderer->boundingRect(region).center());
+    }
 
     updateActions();
     return true;
@@ -460,12 +474,66 @@ void MainWindow::openLastFile()
 }
 
 void MainWindow::openFile()
+{
+    MapReaderInterface *mapReader = 0;
+    const QString fileName = getOpenMapFileName(&mapReader);
+    if (!fileName.isEmpty())
+        openFile(fileName, mapReader);
+}
+
+void MainWindow::openRegion()
+{
+    MapReaderInterface *mapReader = 0;
+    const QString fileName = getOpenMapFileName(&mapReader);
+    if (fileName.isEmpty())
+        return;
+
+    const QString lastRegion =
+            mSettings.value(QLatin1String("lastOpenedRegion"),
+                            QLatin1String("0, 0, 100, 100")).toString();
+
+    bool ok;
+    const QString text =
+            QInputDialog::getText(this, tr("Open Region"),
+                                  tr("Region to load, in tiles "
+                                     "(x, y, width, height):"),
+                                  QLineEdit::Normal, lastRegion, &ok);
+    if (!ok)
+        return;
+
+    const QStringList parts = text.split(QLatin1Char(','));
+    QRect region;
+    if (parts.size() == 4) {
+        region = QRect(parts.at(0).trimmed().toInt(),
+                       parts.at(1).trimmed().toInt(),
+                       parts.at(2).trimmed().toInt(),
+                       parts.at(3).trimmed().toInt());
+    }
+
+    if (!region.isValid()) {
+        QMessageBox::critical(this, tr("Error Opening Map"),
+                              tr("Invalid region: %1").arg(text));
+        return;
+    }
+
+    mSettings.setValue(QLatin1String("lastOpenedRegion"), text);
+    openFile(fileName, mapReader, region);
+}
+
+/**
+ * Asks the user for a map file to open. Returns an empty string when the
+ * dialog was canceled. When a filter of a particular reader was selected,
+ * that reader is returned in \a mapReader.
+ */
+QString MainWindow::getOpenMapFileName(MapReaderInterface **mapReader)
 {
     QString filter = tr("All Files (*)");
     filter += QLatin1String(";;");
 
     QString selectedFilter = tr("Tiled map files (*.tmx)");
     filter += selectedFilter;
+    filter += QLatin1String(";;");
+    filter += tr("Tiled binary map files (*.tmb)");
 
     selectedFilter = mSettings.value(QLatin1String("lastUsedOpenFilter"),
                                      selectedFilter).toString();
@@ -481,17 +549,16 @@ void MainWindow::openFile()
                                                     fileDialogStartLocation(),
                                                     filter, &selectedFilter);
     if (fileName.isEmpty())
-        return;
+        return fileName;
 
     // When a particular filter was selected, use the associated reader
-    MapReaderInterface *mapReader = 0;
     foreach (MapReaderInterface *reader, readers) {
         if (selectedFilter == reader->nameFilter())
-            mapReader = reader;
+            *mapReader = reader;
     }
 
     mSettings.setValue(QLatin1String("lastUsedOpenFilter"), selectedFilter);
-    openFile(fileName, mapReader);
+    return fileName;
 }
 
 bool MainWindow::saveFile(const QString &fileName)
@@ -515,7 +582,9 @@ bool MainWindow::saveFile(const QString &fileName)
 
 bool MainWindow::saveFile()
 {
-    if (mCurrentFileName.endsWith(QLatin1String(".tmx"), Qt::CaseInsensitive))
+    if (mCurrentFileName.endsWith(QLatin1String(".tmx"), Qt::CaseInsensitive)
+        || mCurrentFileName.endsWith(QLatin1String(".tmb"),
+                                     Qt::CaseInsensitive))
         return saveFile(mCurrentFileName);
     else
         return saveFileAs();
@@ -613,10 +682,12 @@ void MainWindow::exportAs()
                 chosenWriter = writer;
     }
 
-    // Also support exporting to the TMX map format when requested
+    // Also support exporting to the TMX and binary map formats when requested
     TmxMapWriter tmxMapWriter;
-    if (!chosenWriter && fileName.endsWith(QLatin1String(".tmx"),
-                                           Qt::CaseInsensitive))
+    if (!chosenWriter && (fileName.endsWith(QLatin1String(".tmx"),
+                                            Qt::CaseInsensitive)
+                          || fileName.endsWith(QLatin1String(".tmb"),
+                                               Qt::CaseInsensitive)))
         chosenWriter = &tmxMapWriter;
 
     if (!chosenWriter) {
@@ -963,6 +1034,14 @@ void MainWindow::updateStatusInfoLabel(const QString &statusInfo)
     mStatusInfoLabel->setText(statusInfo);
 }
 
+void MainWindow::tilesetLoadFailed(Tileset *tileset)
+{
+    QMessageBox::warning(this, tr("Error Loading Tileset Image"),
+                         tr("Failed to load the image of tileset '%1' from "
+                            "%2. Its tiles will be shown as empty.")
+                         .arg(tileset->name(), tileset->imageSource()));
+}
+
 void MainWindow::writeSettings()
 {
     mSettings.beginGroup(QLatin1String("mainwindow"));
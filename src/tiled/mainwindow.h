@@ -40,6 +40,7 @@ class MainWindow;
 namespace Tiled {
 
 class TileLayer;
+class Tileset;
 class MapReaderInterface;
 
 namespace Internal {
@@ -75,9 +76,15 @@ public:
      * When a \a reader is given, it is used to open the file. Otherwise, a
      * reader is searched using MapReaderInterface::supportsFile.
      *
+     * When a \a region is given, only that part of the map is loaded. Such
+     * a map is opened as a new file, so that saving it can't overwrite the
+     * rest of the map. Only maps read by the TmxMapReader can be partially
+     * loaded.
+     *
      * @return whether the file was succesfully opened
      */
-    bool openFile(const QString &fileName, MapReaderInterface *reader = 0);
+    bool openFile(const QString &fileName, MapReaderInterface *reader = 0,
+                  const QRect &region = QRect());
 
     /**
      * Attempt to open the previously opened file.
@@ -95,6 +102,7 @@ protected:
 private slots:
     void newMap();
     void openFile();
+    void openRegion();
     bool saveFile();
     bool saveFileAs();
     void saveAsImage();
@@ -123,6 +131,7 @@ private slots:
 
     void setStampBrush(const TileLayer *tiles);
     void updateStatusInfoLabel(const QString &statusInfo);
+    void tilesetLoadFailed(Tileset *tileset);
 
     void selectQuickStamp(int index);
     void saveQuickStamp(int index);
@@ -150,6 +159,7 @@ private:
     void setMapDocument(MapDocument *mapDocument);
     QStringList recentFiles() const;
     QString fileDialogStartLocation() const;
+    QString getOpenMapFileName(MapReaderInterface **mapReader);
 
     /**
      * Add the given file to the recent files list.
@@ -48,7 +48,9 @@ MapDocument::MapDocument(Map *map, const QString &fileName):
     mFileName(fileName),
     mMap(map),
     mLayerModel(new LayerModel(this)),
-    mUndoStack(new QUndoStack(this))
+    mUndoStack(new QUndoStack(this)),
+    mChangeDepth(0),
+    mMapChangePending(false)
 {
     switch (map->orientation()) {
     case Map::Isometric:
@@ -340,14 +342,48 @@ void MapDocument::unifyTilesets(Map *map)
  */
 void MapDocument::emitMapChanged()
 {
+    if (mChangeDepth > 0) {
+        mMapChangePending = true;
+        return;
+    }
+
     emit mapChanged();
 }
 
 void MapDocument::emitRegionChanged(const QRegion &region)
 {
+    if (mChangeDepth > 0) {
+        foreach (const QRect &rect, region.rects())
+            mPendingRegion.addRect(rect);
+        return;
+    }
+
     emit regionChanged(region);
 }
 
+void MapDocument::beginChanges()
+{
+    ++mChangeDepth;
+}
+
+void MapDocument::endChanges()
+{
+    Q_ASSERT(mChangeDepth > 0);
+    if (--mChangeDepth > 0)
+        return;
+
+    if (mMapChangePending) {
+        mMapChangePending = false;
+        emit mapChanged();
+    }
+
+    if (!mPendingRegion.isEmpty()) {
+        const QRegion region = mPendingRegion.region();
+        mPendingRegion.clear();
+        emit regionChanged(region);
+    }
+}
+
 /**
  * Emits the objects added signal with the specified list of objects.
  * This will cause the scene to insert the related items.
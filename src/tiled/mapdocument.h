@@ -22,6 +22,8 @@
 #ifndef MAPDOCUMENT_H
 #define MAPDOCUMENT_H
 
+#include "regionbuilder.h"
+
 #include <QObject>
 #include <QRegion>
 #include <QString>
@@ -166,6 +168,22 @@ public:
      */
     void emitRegionChanged(const QRegion &region);
 
+    /**
+     * Starts a batch of changes. Until the matching endChanges(), the map
+     * changed and region changed signals are held back. Calls may be nested.
+     *
+     * Use this around operations that paint many separate parts of the map,
+     * like automapping, to avoid updating the views for each of them.
+     */
+    void beginChanges();
+
+    /**
+     * Ends a batch of changes started with beginChanges(). When the outermost
+     * batch ends, the map changed signal is emitted at most once, followed by
+     * a single region changed signal covering all changed regions.
+     */
+    void endChanges();
+
     void emitObjectsAdded(const QList<MapObject*> &objects);
     void emitObjectsRemoved(const QList<MapObject*> &objects);
     void emitObjectsChanged(const QList<MapObject*> &objects);
@@ -233,6 +251,10 @@ private:
     MapRenderer *mRenderer;
     int mCurrentLayer;
     QUndoStack *mUndoStack;
+
+    int mChangeDepth;
+    bool mMapChangePending;
+    RegionBuilder mPendingRegion;
 };
 
 } // namespace Internal
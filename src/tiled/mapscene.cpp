@@ -31,6 +31,8 @@
 #include "maprenderer.h"
 #include "objectgroup.h"
 #include "objectgroupitem.h"
+#include "regionbuilder.h"
+#include "tile.h"
 #include "tilelayer.h"
 #include "tilelayeritem.h"
 #include "tileselectionitem.h"
@@ -66,6 +68,8 @@ MapScene::MapScene(QObject *parent):
     TilesetManager *tilesetManager = TilesetManager::instance();
     connect(tilesetManager, SIGNAL(tilesetChanged(Tileset*)),
             this, SLOT(tilesetChanged(Tileset*)));
+    connect(tilesetManager, SIGNAL(tilesChanged(Tileset*,QSet<int>)),
+            this, SLOT(tilesChanged(Tileset*,QSet<int>)));
 
     // Install an event filter so that we can get key events on behalf of the
     // active tool without having to have the current focus.
@@ -251,8 +255,6 @@ void MapScene::currentLayerChanged()
     updateInteractionMode();
 }
 
-#include <QtDebug>
-
 /**
  * Adapts the scene rect and layers to the new map size.
  */
@@ -261,8 +263,6 @@ void MapScene::mapChanged()
     const QRect mapSize = mMapDocument->renderer()->mapSize();
     setSceneRect(mapSize);
 
-    qDebug() << "Map changed!";
-  
     foreach (QGraphicsItem *item, mLayerItems) {
         if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
             tli->syncWithTileLayer();
@@ -278,6 +278,48 @@ void MapScene::tilesetChanged(Tileset *tileset)
         update();
 }
 
+/**
+ * Repaints only the cells that show one of the changed tiles. Layers that
+ * haven't been loaded yet were never painted, so they are left alone.
+ */
+void MapScene::tilesChanged(Tileset *tileset, const QSet<int> &tileIds)
+{
+    if (!mMapDocument)
+        return;
+
+    Map *map = mMapDocument->map();
+    if (!map->tilesets().contains(tileset))
+        return;
+
+    RegionBuilder region;
+
+    foreach (Layer *layer, map->layers()) {
+        TileLayer *tileLayer = dynamic_cast<TileLayer*>(layer);
+        if (!tileLayer || !tileLayer->isLoaded()
+                || !tileLayer->referencesTileset(tileset))
+            continue;
+
+        TileIterator it(tileLayer);
+        while (it.hasNext()) {
+            it.next();
+            const Tile *tile = it.tile();
+            if (tile->tileset() == tileset && tileIds.contains(tile->id()))
+                region.addPoint(it.x() + tileLayer->x(),
+                                it.y() + tileLayer->y());
+        }
+    }
+
+    if (!region.isEmpty())
+        repaintRegion(region.region());
+
+    ObjectItems::const_iterator it = mObjectItems.constBegin();
+    for (; it != mObjectItems.constEnd(); ++it) {
+        const Tile *tile = it.key()->tile();
+        if (tile && tile->tileset() == tileset && tileIds.contains(tile->id()))
+            it.value()->update();
+    }
+}
+
 void MapScene::layerAdded(int index)
 {
     Layer *layer = mMapDocument->map()->layerAt(index);
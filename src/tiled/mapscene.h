@@ -26,6 +26,7 @@
 
 #include <QGraphicsScene>
 #include <QMap>
+#include <QSet>
 
 class QModelIndex;
 
@@ -125,6 +126,7 @@ private slots:
 
     void mapChanged();
     void tilesetChanged(Tileset *tileset);
+    void tilesChanged(Tileset *tileset, const QSet<int> &tileIds);
 
     void layerAdded(int index);
     void layerRemoved(int index);
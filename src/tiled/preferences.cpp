@@ -21,6 +21,7 @@
 #include "preferences.h"
 
 #include "languagemanager.h"
+#include "tilesetcache.h"
 #include "tilesetmanager.h"
 
 #include <QSettings>
@@ -51,9 +52,13 @@ Preferences::Preferences()
     mLayerDataFormat = (MapWriter::LayerDataFormat)
                        mSettings->value(QLatin1String("LayerDataFormat"),
                                         MapWriter::Base64Gzip).toInt();
+    mChunkedLayerData =
+            mSettings->value(QLatin1String("ChunkedLayerData")).toBool();
     mDtdEnabled = mSettings->value(QLatin1String("DtdEnabled")).toBool();
     mReloadTilesetsOnChange =
             mSettings->value(QLatin1String("ReloadTilesets"), true).toBool();
+    mImageCacheDirectory =
+            mSettings->value(QLatin1String("ImageCacheDirectory")).toString();
     mSettings->endGroup();
 
     // Retrieve interface settings
@@ -65,6 +70,8 @@ Preferences::Preferences()
 
     TilesetManager *tilesetManager = TilesetManager::instance();
     tilesetManager->setReloadTilesetsOnChange(mReloadTilesetsOnChange);
+
+    TilesetCache::instance()->setDiskCacheDirectory(mImageCacheDirectory);
 }
 
 Preferences::~Preferences()
@@ -88,6 +95,17 @@ void Preferences::setLayerDataFormat(MapWriter::LayerDataFormat
                         mLayerDataFormat);
 }
 
+bool Preferences::chunkedLayerData() const
+{
+    return mChunkedLayerData;
+}
+
+void Preferences::setChunkedLayerData(bool enabled)
+{
+    mChunkedLayerData = enabled;
+    mSettings->setValue(QLatin1String("Storage/ChunkedLayerData"), enabled);
+}
+
 bool Preferences::dtdEnabled() const
 {
     return mDtdEnabled;
@@ -134,6 +152,23 @@ void Preferences::setReloadTilesetsOnChanged(bool value)
     tilesetManager->setReloadTilesetsOnChange(mReloadTilesetsOnChange);
 }
 
+QString Preferences::imageCacheDirectory() const
+{
+    return mImageCacheDirectory;
+}
+
+void Preferences::setImageCacheDirectory(const QString &path)
+{
+    if (mImageCacheDirectory == path)
+        return;
+
+    mImageCacheDirectory = path;
+    mSettings->setValue(QLatin1String("Storage/ImageCacheDirectory"),
+                        mImageCacheDirectory);
+
+    TilesetCache::instance()->setDiskCacheDirectory(mImageCacheDirectory);
+}
+
 void Preferences::setUseOpenGL(bool useOpenGL)
 {
     if (mUseOpenGL == useOpenGL)
@@ -45,6 +45,12 @@ public:
     MapWriter::LayerDataFormat layerDataFormat() const;
     void setLayerDataFormat(MapWriter::LayerDataFormat layerDataFormat);
 
+    /**
+     * Whether saved maps only store the non-empty chunks of tile layers.
+     */
+    bool chunkedLayerData() const;
+    void setChunkedLayerData(bool enabled);
+
     bool dtdEnabled() const;
     void setDtdEnabled(bool enabled);
 
@@ -54,6 +60,13 @@ public:
     bool reloadTilesetsOnChange() const;
     void setReloadTilesetsOnChanged(bool value);
 
+    /**
+     * The directory in which decoded tileset images are kept between runs,
+     * or an empty string when they aren't kept.
+     */
+    QString imageCacheDirectory() const;
+    void setImageCacheDirectory(const QString &path);
+
     bool useOpenGL() const { return mUseOpenGL; }
     void setUseOpenGL(bool useOpenGL);
 
@@ -72,9 +85,11 @@ private:
 
     QSettings *mSettings;
     MapWriter::LayerDataFormat mLayerDataFormat;
+    bool mChunkedLayerData;
     bool mDtdEnabled;
     QString mLanguage;
     bool mReloadTilesetsOnChange;
+    QString mImageCacheDirectory;
     bool mUseOpenGL;
 
     static Preferences *mInstance;
@@ -101,6 +101,7 @@ void PreferencesDialog::fromPreferences()
     const Preferences *prefs = Preferences::instance();
     mUi->reloadTilesetImages->setChecked(prefs->reloadTilesetsOnChange());
     mUi->enableDtd->setChecked(prefs->dtdEnabled());
+    mUi->chunkedLayerData->setChecked(prefs->chunkedLayerData());
     if (mUi->openGL->isEnabled())
         mUi->openGL->setChecked(prefs->useOpenGL());
 
@@ -139,6 +140,7 @@ void PreferencesDialog::toPreferences()
     prefs->setReloadTilesetsOnChanged(mUi->reloadTilesetImages->isChecked());
     prefs->setDtdEnabled(mUi->enableDtd->isChecked());
     prefs->setLayerDataFormat(layerDataFormat());
+    prefs->setChunkedLayerData(mUi->chunkedLayerData->isChecked());
 }
 
 MapWriter::LayerDataFormat PreferencesDialog::layerDataFormat() const
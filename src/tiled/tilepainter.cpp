@@ -24,6 +24,7 @@
 #include "mapdocument.h"
 #include "tilelayer.h"
 #include "map.h"
+#include "regionbuilder.h"
 
 #include <QDebug>
 
@@ -31,12 +32,15 @@ using namespace Tiled;
 using namespace Tiled::Internal;
 
 // are utility functions meant to be members? god, I don't know
-void RefreshMapSizes(MapDocument *map, TileLayer *tilelayer) {
-  // may have resized, may not have, so update things.
-  // Todo: tell it which map changed, or only emit if it really did resize?
-  
+static void RefreshMapSizes(MapDocument *map, TileLayer *tilelayer,
+                            const QRect &oldBounds) {
+  // Painting can only grow the layer, and the map along with it. The views
+  // only need to know when that actually happened.
+  if (tilelayer->bounds() == oldBounds)
+    return;
+
   map->map()->setSize(map->map()->size().united(tilelayer->bounds()));
-  
+
   map->emitMapChanged();
 }
 
@@ -65,10 +69,11 @@ void TilePainter::setTile(int x, int y, Tile *tile)
 
     const int layerX = x - mTileLayer->x();
     const int layerY = y - mTileLayer->y();
-    
+    const QRect oldBounds = mTileLayer->bounds();
+
     mTileLayer->setTile(layerX, layerY, tile);
-    
-    RefreshMapSizes(mMapDocument, mTileLayer);
+
+    RefreshMapSizes(mMapDocument, mTileLayer, oldBounds);
     
     mMapDocument->emitRegionChanged(QRegion(x, y, 1, 1));
 }
@@ -81,45 +86,42 @@ void TilePainter::setTiles(int x, int y, TileLayer *tiles, const QRegion &mask)
     if (region.isEmpty())
         return;
 
-    foreach (const QRect &rect, region.rects()) {
-        for (int _x = rect.left(); _x <= rect.right(); ++_x) {
-            for (int _y = rect.top(); _y <= rect.bottom(); ++_y) {
-                mTileLayer->setTile(_x - mTileLayer->x(),
-                                    _y - mTileLayer->y(),
-                                    tiles->tileAt(_x - x, _y - y));
-            }
-        }
-    }
+    const QPoint layerPos(mTileLayer->x(), mTileLayer->y());
+    const QRect oldBounds = mTileLayer->bounds();
+
+    foreach (const QRect &rect, region.rects())
+        mTileLayer->copyRect(rect.translated(-layerPos), tiles,
+                             rect.topLeft() - QPoint(x, y));
 
-    RefreshMapSizes(mMapDocument, mTileLayer);
+    RefreshMapSizes(mMapDocument, mTileLayer, oldBounds);
     
     mMapDocument->emitRegionChanged(region);
 }
 
 void TilePainter::drawTiles(int x, int y, TileLayer *tiles)
+{
+    drawTiles(x, y, tiles, QRect(0, 0, tiles->width(), tiles->height()));
+}
+
+void TilePainter::drawTiles(int x, int y, const TileLayer *tiles,
+                            const QRect &sourceRect)
 {
     const QRegion region = paintableRegion(x, y,
-                                           tiles->width(),
-                                           tiles->height());
+                                           sourceRect.width(),
+                                           sourceRect.height());
     if (region.isEmpty())
         return;
 
-    foreach (const QRect &rect, region.rects()) {
-        for (int _x = rect.left(); _x <= rect.right(); ++_x) {
-            for (int _y = rect.top(); _y <= rect.bottom(); ++_y) {
-                Tile * const tile = tiles->tileAt(_x - x, _y - y);
-                if (!tile)
-                    continue;
+    const QPoint layerPos(mTileLayer->x(), mTileLayer->y());
+    const QPoint sourceOffset = sourceRect.topLeft() - QPoint(x, y);
+    const QRect oldBounds = mTileLayer->bounds();
+
+    foreach (const QRect &rect, region.rects())
+        mTileLayer->mergeRect(rect.translated(-layerPos), tiles,
+                              rect.topLeft() + sourceOffset);
+
+    RefreshMapSizes(mMapDocument, mTileLayer, oldBounds);
 
-                mTileLayer->setTile(_x - mTileLayer->x(),
-                                    _y - mTileLayer->y(),
-                                    tile);
-            }
-        }
-    }
-    
-    RefreshMapSizes(mMapDocument, mTileLayer);
-    
     mMapDocument->emitRegionChanged(region);
 }
 
@@ -134,26 +136,14 @@ void TilePainter::drawStamp(const TileLayer *stamp,
     if (region.isEmpty())
         return;
 
-    const int w = stamp->width();
-    const int h = stamp->height();
-    const QRect regionBounds = region.boundingRect();
-
-    foreach (const QRect &rect, region.rects()) {
-        for (int _x = rect.left(); _x <= rect.right(); ++_x) {
-            for (int _y = rect.top(); _y <= rect.bottom(); ++_y) {
-                Tile *tile = stamp->tileAt((_x - regionBounds.left()) % w,
-                                           (_y - regionBounds.top()) % h);
-                if (!tile)
-                    continue;
-
-                mTileLayer->setTile(_x - mTileLayer->x(),
-                                    _y - mTileLayer->y(),
-                                    tile);
-            }
-        }
-    }
+    const QPoint layerPos(mTileLayer->x(), mTileLayer->y());
+    const QPoint origin = region.boundingRect().topLeft() - layerPos;
+    const QRect oldBounds = mTileLayer->bounds();
+
+    foreach (const QRect &rect, region.rects())
+        mTileLayer->fillStamp(rect.translated(-layerPos), stamp, origin);
 
-    RefreshMapSizes(mMapDocument, mTileLayer);
+    RefreshMapSizes(mMapDocument, mTileLayer, oldBounds);
     
     mMapDocument->emitRegionChanged(region);
 }
@@ -164,15 +154,9 @@ void TilePainter::erase(const QRegion &region)
     if (paintable.isEmpty())
         return;
 
-    foreach (const QRect &rect, paintable.rects()) {
-        for (int _x = rect.left(); _x <= rect.right(); ++_x) {
-            for (int _y = rect.top(); _y <= rect.bottom(); ++_y) {
-                mTileLayer->setTile(_x - mTileLayer->x(),
-                                    _y - mTileLayer->y(),
-                                    0);
-            }
-        }
-    }
+    const QPoint layerPos(mTileLayer->x(), mTileLayer->y());
+    foreach (const QRect &rect, paintable.rects())
+        mTileLayer->clearRect(rect.translated(-layerPos));
 
     mMapDocument->emitRegionChanged(paintable);
 }
@@ -180,11 +164,11 @@ void TilePainter::erase(const QRegion &region)
 QRegion TilePainter::computeFillRegion(const QPoint &fillOrigin) const
 {
     // Create that region that will hold the fill
-    QRegion fillRegion;
+    RegionBuilder fillRegion;
 
     // Silently quit if parameters are unsatisfactory
     if (!isDrawable(fillOrigin.x(), fillOrigin.y()))
-        return fillRegion;
+        return QRegion();
 
     // Cache tile that we will match other tiles against
     const Tile *matchTile = tileAt(fillOrigin.x(), fillOrigin.y());
@@ -222,7 +206,7 @@ QRegion TilePainter::computeFillRegion(const QPoint &fillOrigin) const
             ++right;
 
         // Add tiles between left and right to the region
-        fillRegion += QRegion(left, currentPoint.y(), right - left + 1, 1);
+        fillRegion.addSpan(left, currentPoint.y(), right - left + 1);
 
         // Add tile strip to processed tiles
         memset(&processedTiles[startOfLine + left],
@@ -278,7 +262,7 @@ QRegion TilePainter::computeFillRegion(const QPoint &fillOrigin) const
         }
     }
 
-    return fillRegion;
+    return fillRegion.region();
 }
 
 bool TilePainter::isDrawable(int x, int y) const
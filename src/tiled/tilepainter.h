@@ -40,6 +40,10 @@ class MapDocument;
  *
  * This class also does bounds checking and when there is a tile selection, it
  * will only draw within this selection.
+ *
+ * When painting many separate areas, wrap the operations in
+ * MapDocument::beginChanges() and MapDocument::endChanges() so that the
+ * views are only updated once.
  */
 class TilePainter
 {
@@ -83,6 +87,16 @@ public:
      */
     void drawTiles(int x, int y, TileLayer *tiles);
 
+    /**
+     * Draws the tiles within \a sourceRect of the given tile layer, placing
+     * the top-left corner of the rectangle at the given coordinates. The
+     * coordinates \a x and \a y are relative to the map origin.
+     *
+     * Empty tiles are skipped.
+     */
+    void drawTiles(int x, int y, const TileLayer *tiles,
+                   const QRect &sourceRect);
+
     /**
      * Draws the stamp within the given \a drawRegion region, repeating the
      * stamp as needed.
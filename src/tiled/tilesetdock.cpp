@@ -71,7 +71,10 @@ TilesetDock::TilesetDock(QWidget *parent):
     connect(mViewStack, SIGNAL(currentChanged(int)),
             this, SLOT(updateCurrentTiles()));
 
-    connect(TilesetManager::instance(), SIGNAL(tilesetChanged(Tileset*)),
+    TilesetManager *tilesetManager = TilesetManager::instance();
+    connect(tilesetManager, SIGNAL(tilesetChanged(Tileset*)),
+            this, SLOT(tilesetChanged(Tileset*)));
+    connect(tilesetManager, SIGNAL(tilesChanged(Tileset*,QSet<int>)),
             this, SLOT(tilesetChanged(Tileset*)));
 
     setWidget(w);
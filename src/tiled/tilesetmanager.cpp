@@ -22,9 +22,13 @@
 #include "tilesetmanager.h"
 
 #include "tileset.h"
+#include "tilesetcache.h"
 
+#include <QDebug>
 #include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QImage>
+#include <QtConcurrentRun>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -66,29 +70,28 @@ void TilesetManager::deleteInstance()
     mInstance = 0;
 }
 
-Tileset *TilesetManager::findTileset(const QString &fileName) const
+/**
+ * Returns the specification of the given \a tileset.
+ */
+static TilesetSpec specOf(const Tileset *tileset)
 {
-    foreach (Tileset *tileset, tilesets())
-        if (tileset->fileName() == fileName)
-            return tileset;
+    TilesetSpec spec;
+    spec.imageSource = tileset->imageSource();
+    spec.tileWidth = tileset->tileWidth();
+    spec.tileHeight = tileset->tileHeight();
+    spec.tileSpacing = tileset->tileSpacing();
+    spec.margin = tileset->margin();
+    return spec;
+}
 
-    return 0;
+Tileset *TilesetManager::findTileset(const QString &fileName) const
+{
+    return mTilesetsByFileName.value(fileName);
 }
 
 Tileset *TilesetManager::findTileset(const TilesetSpec &spec) const
 {
-    foreach (Tileset *tileset, tilesets()) {
-        if (tileset->imageSource() == spec.imageSource
-            && tileset->tileWidth() == spec.tileWidth
-            && tileset->tileHeight() == spec.tileHeight
-            && tileset->tileSpacing() == spec.tileSpacing
-            && tileset->margin() == spec.margin)
-        {
-            return tileset;
-        }
-    }
-
-    return 0;
+    return mTilesetsBySpec.value(spec);
 }
 
 void TilesetManager::addReference(Tileset *tileset)
@@ -97,8 +100,18 @@ void TilesetManager::addReference(Tileset *tileset)
         mTilesets[tileset]++;
     } else {
         mTilesets.insert(tileset, 1);
-        if (!tileset->imageSource().isEmpty())
+        if (!tileset->fileName().isEmpty())
+            mTilesetsByFileName.insert(tileset->fileName(), tileset);
+        mTilesetsBySpec.insert(specOf(tileset), tileset);
+        if (!tileset->imageSource().isEmpty()) {
             mWatcher->addPath(tileset->imageSource());
+
+            // The hashes are needed to tell what changed on the first reload
+            if (tileset->hasPlaceholderTiles())
+                loadTilesetImage(tileset, true);
+            else
+                loadTilesetImage(tileset, true, true);
+        }
     }
 }
 
@@ -109,13 +122,33 @@ void TilesetManager::removeReference(Tileset *tileset)
 
     if (mTilesets.value(tileset) == 0) {
         mTilesets.remove(tileset);
+        mTilesetsByFileName.remove(tileset->fileName(), tileset);
+        mTilesetsBySpec.remove(specOf(tileset), tileset);
+        mTileHashes.remove(tileset);
+        mLoadGenerations.remove(tileset);
         if (!tileset->imageSource().isEmpty())
             mWatcher->removePath(tileset->imageSource());
 
+        QMap<QFutureWatcher<LoadedImage>*, PendingImage>::iterator it;
+        for (it = mLoadingImages.begin(); it != mLoadingImages.end(); ++it)
+            if (it.value().tileset == tileset)
+                it.value().tileset = 0;
+
         delete tileset;
     }
 }
 
+void TilesetManager::setFileName(Tileset *tileset, const QString &fileName)
+{
+    if (mTilesets.contains(tileset)) {
+        mTilesetsByFileName.remove(tileset->fileName(), tileset);
+        if (!fileName.isEmpty())
+            mTilesetsByFileName.insert(fileName, tileset);
+    }
+
+    tileset->setFileName(fileName);
+}
+
 void TilesetManager::addReferences(const QList<Tileset*> &tilesets)
 {
     foreach (Tileset *tileset, tilesets)
@@ -159,11 +192,155 @@ void TilesetManager::fileChangedTimeout()
 {
     foreach (Tileset *tileset, tilesets()) {
         QString fileName = tileset->imageSource();
-        if (mChangedFiles.contains(fileName)) {
-            tileset->loadFromImage(QImage(fileName), fileName);
-            emit tilesetChanged(tileset);
-        }
+        if (mChangedFiles.contains(fileName))
+            loadTilesetImage(tileset, false);
     }
 
     mChangedFiles.clear();
 }
+
+/**
+ * Returns a 64-bit FNV-1a hash of the pixels of \a image within \a rect.
+ */
+static quint64 hashPixels(const QImage &image, const QRect &rect)
+{
+    const int bytesPerPixel = image.depth() / 8;
+    const int rowOffset = rect.x() * bytesPerPixel;
+    const int rowLength = rect.width() * bytesPerPixel;
+
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const uchar *byte = image.scanLine(y) + rowOffset;
+        const uchar *end = byte + rowLength;
+        for (; byte != end; ++byte) {
+            hash ^= *byte;
+            hash *= Q_UINT64_C(1099511628211);
+        }
+    }
+    return hash;
+}
+
+/**
+ * Decodes the image of a tileset, applies its transparent color and hashes
+ * each of its tiles, laid out like Tileset::loadFromImage() does. Runs on a
+ * worker thread.
+ */
+TilesetManager::LoadedImage
+TilesetManager::readTilesetImage(const TilesetSpec &spec,
+                                 const QColor &transparentColor,
+                                 bool useCache)
+{
+    const QString &fileName = spec.imageSource;
+    TilesetCache *cache = TilesetCache::instance();
+    const QImage image = useCache ? cache->image(fileName)
+                                  : cache->reloadImage(fileName);
+
+    LoadedImage loaded;
+    loaded.atlasImage = Tileset::atlasImage(image, transparentColor);
+    loaded.tileHashes.spec = spec;
+
+    if (loaded.atlasImage.isNull() || spec.tileWidth <= 0
+            || spec.tileHeight <= 0)
+        return loaded;
+
+    // Hash colors rather than palette indices, which also makes every pixel
+    // take whole bytes
+    QImage pixels = loaded.atlasImage;
+    if (pixels.depth() <= 8)
+        pixels = pixels.convertToFormat(QImage::Format_ARGB32);
+
+    const int stopWidth = pixels.width() - spec.tileWidth;
+    const int stopHeight = pixels.height() - spec.tileHeight;
+    const int stepX = spec.tileWidth + spec.tileSpacing;
+    const int stepY = spec.tileHeight + spec.tileSpacing;
+
+    for (int y = spec.margin; y <= stopHeight; y += stepY) {
+        for (int x = spec.margin; x <= stopWidth; x += stepX) {
+            const QRect rect(x, y, spec.tileWidth, spec.tileHeight);
+            loaded.tileHashes.hashes.append(hashPixels(pixels, rect));
+        }
+    }
+
+    return loaded;
+}
+
+/**
+ * Starts loading the image of the given \a tileset on a worker thread. When
+ * the image is known to have changed, \a useCache should be false, since
+ * the cache can't tell changes that happen within a second. The image is
+ * then decoded again and replaces the cached one. With
+ * \a hashesOnly, the tileset keeps its image and only the hashes of its
+ * tiles are remembered.
+ *
+ * Any load of the tileset that is still running is superseded.
+ */
+void TilesetManager::loadTilesetImage(Tileset *tileset, bool useCache,
+                                      bool hashesOnly)
+{
+    QFutureWatcher<LoadedImage> *watcher =
+            new QFutureWatcher<LoadedImage>(this);
+    connect(watcher, SIGNAL(finished()),
+            this, SLOT(tilesetImageLoaded()));
+
+    PendingImage pending;
+    pending.tileset = tileset;
+    pending.generation = ++mLoadGenerations[tileset];
+    pending.hashesOnly = hashesOnly;
+
+    mLoadingImages.insert(watcher, pending);
+    watcher->setFuture(QtConcurrent::run(readTilesetImage,
+                                         specOf(tileset),
+                                         tileset->transparentColor(),
+                                         useCache));
+}
+
+void TilesetManager::tilesetImageLoaded()
+{
+    QFutureWatcher<LoadedImage> *watcher =
+            static_cast<QFutureWatcher<LoadedImage>*>(sender());
+    const PendingImage pending = mLoadingImages.take(watcher);
+    const LoadedImage loaded = watcher->result();
+    watcher->deleteLater();
+
+    // The tileset may be gone, or a later load may have been started
+    Tileset *tileset = pending.tileset;
+    if (!tileset || pending.generation != mLoadGenerations.value(tileset))
+        return;
+
+    if (pending.hashesOnly) {
+        if (loaded.tileHashes.spec == specOf(tileset))
+            mTileHashes.insert(tileset, loaded.tileHashes);
+        return;
+    }
+
+    const bool hadPlaceholderTiles = tileset->hasPlaceholderTiles();
+    const int previousColumnCount = tileset->columnCount();
+    const QString &fileName = tileset->imageSource();
+    if (!tileset->loadFromAtlasImage(loaded.atlasImage, fileName)) {
+        qDebug() << "Error loading tileset image" << fileName;
+        emit tilesetLoadFailed(tileset);
+        return;
+    }
+
+    const TileHashes previous = mTileHashes.value(tileset);
+    const TileHashes &current = loaded.tileHashes;
+    mTileHashes.insert(tileset, current);
+
+    // Without comparable hashes, everything needs to be updated
+    if (hadPlaceholderTiles
+            || previous.hashes.size() != current.hashes.size()
+            || previousColumnCount != tileset->columnCount()
+            || !(previous.spec == current.spec)
+            || !(current.spec == specOf(tileset))) {
+        emit tilesetChanged(tileset);
+        return;
+    }
+
+    QSet<int> changedTileIds;
+    for (int id = 0; id < current.hashes.size(); ++id)
+        if (previous.hashes.at(id) != current.hashes.at(id))
+            changedTileIds.insert(id);
+
+    if (!changedTileIds.isEmpty())
+        emit tilesChanged(tileset, changedTileIds);
+}
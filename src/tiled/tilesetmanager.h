@@ -23,14 +23,20 @@
 #define TILESETMANAGER_H
 
 #include <QObject>
+#include <QHash>
 #include <QList>
 #include <QMap>
+#include <QImage>
 #include <QString>
 #include <QSet>
 #include <QTimer>
+#include <QVector>
 
+class QColor;
 class QFileSystemWatcher;
 
+template <typename T> class QFutureWatcher;
+
 namespace Tiled {
 
 class Tileset;
@@ -50,10 +56,36 @@ struct TilesetSpec
     int margin;
 };
 
+inline bool operator==(const TilesetSpec &a, const TilesetSpec &b)
+{
+    return a.imageSource == b.imageSource
+            && a.tileWidth == b.tileWidth
+            && a.tileHeight == b.tileHeight
+            && a.tileSpacing == b.tileSpacing
+            && a.margin == b.margin;
+}
+
+inline uint qHash(const TilesetSpec &spec)
+{
+    return qHash(spec.imageSource)
+            ^ (uint(spec.tileWidth) << 16) ^ uint(spec.tileHeight)
+            ^ (uint(spec.tileSpacing) << 24) ^ (uint(spec.margin) << 8);
+}
+
 /**
  * The tileset manager keeps track of all tilesets used by loaded maps. It also
  * watches the tileset images for changes and will attempt to reload them when
  * they change.
+ *
+ * Tileset images are decoded on worker threads. Tilesets that are still
+ * showing placeholder tiles when they are added get their image loaded in
+ * the background, and tilesetChanged() is emitted once it is in place.
+ *
+ * When a tileset image is reloaded after it changed on disk, its tiles are
+ * compared to the previous version, and only tilesChanged() is emitted for
+ * the tiles that actually look different. To have something to compare to,
+ * the tiles of the other tilesets are hashed in the background when they
+ * are added.
  */
 class TilesetManager : public QObject
 {
@@ -72,7 +104,9 @@ public:
     static void deleteInstance();
 
     /**
-     * Searches for a tileset matching the given file name.
+     * Searches for a tileset matching the given file name. The editor reads
+     * external tilesets by their canonical file name, so that is what this
+     * should be given as well.
      * @return a tileset matching the given file name, or 0 if none exists
      */
     Tileset *findTileset(const QString &fileName) const;
@@ -95,6 +129,13 @@ public:
      */
     void removeReference(Tileset *tileset);
 
+    /**
+     * Changes the file name of the given \a tileset. This should be used
+     * instead of Tileset::setFileName() for tilesets that have references,
+     * so that they can still be found by their file name.
+     */
+    void setFileName(Tileset *tileset, const QString &fileName);
+
     /**
      * Convenience method to add references to multiple tilesets.
      * @see addReference
@@ -127,9 +168,23 @@ signals:
      */
     void tilesetChanged(Tileset *tileset);
 
+    /**
+     * Emitted when the tileset image of \a tileset was reloaded and only the
+     * tiles with the given \a tileIds look different. The layout of the
+     * tileset stayed the same.
+     */
+    void tilesChanged(Tileset *tileset, const QSet<int> &tileIds);
+
+    /**
+     * Emitted when the image of \a tileset could not be decoded after the
+     * map was opened. The tileset keeps its placeholder tiles.
+     */
+    void tilesetLoadFailed(Tileset *tileset);
+
 private slots:
     void fileChanged(const QString &path);
     void fileChangedTimeout();
+    void tilesetImageLoaded();
 
 private:
     Q_DISABLE_COPY(TilesetManager)
@@ -144,12 +199,70 @@ private:
      */
     ~TilesetManager();
 
+    /**
+     * The hashes of the tiles in a tileset image, along with the layout of
+     * the tileset they were computed for.
+     */
+    struct TileHashes
+    {
+        TilesetSpec spec;
+        QVector<quint64> hashes;
+    };
+
+    struct LoadedImage
+    {
+        QImage atlasImage;
+        TileHashes tileHashes;
+    };
+
+    /**
+     * A tileset image being decoded. Only the latest load of a tileset is
+     * used, earlier ones are superseded.
+     */
+    struct PendingImage
+    {
+        Tileset *tileset;
+        int generation;
+        bool hashesOnly;
+    };
+
+    void loadTilesetImage(Tileset *tileset, bool useCache,
+                          bool hashesOnly = false);
+
+    static LoadedImage readTilesetImage(const TilesetSpec &spec,
+                                        const QColor &transparentColor,
+                                        bool useCache);
+
     static TilesetManager *mInstance;
 
     /**
      * Stores the tilesets and maps them to the number of references.
      */
     QMap<Tileset*, int> mTilesets;
+
+    /**
+     * Indexes of the referenced tilesets, used for quickly finding them.
+     */
+    QMultiHash<QString, Tileset*> mTilesetsByFileName;
+    QMultiHash<TilesetSpec, Tileset*> mTilesetsBySpec;
+
+    /**
+     * The tileset images being decoded. The tileset is set to 0 when it is
+     * deleted in the meantime.
+     */
+    QMap<QFutureWatcher<LoadedImage>*, PendingImage> mLoadingImages;
+
+    /**
+     * The generation of the latest load started for each tileset.
+     */
+    QHash<Tileset*, int> mLoadGenerations;
+
+    /**
+     * The tile hashes of the tileset images loaded so far, used to find out
+     * which tiles changed when an image is reloaded.
+     */
+    QHash<Tileset*, TileHashes> mTileHashes;
+
     QFileSystemWatcher *mWatcher;
     QSet<QString> mChangedFiles;
     QTimer mChangedFilesTimer;
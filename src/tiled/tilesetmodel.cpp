@@ -57,13 +57,11 @@ int TilesetModel::columnCount(const QModelIndex &parent) const
     return parent.isValid() ? 0 : mTileset->columnCount();
 }
 
-QVariant TilesetModel::data(const QModelIndex &index, int role) const
+QVariant TilesetModel::data(const QModelIndex & /* index */,
+                           int /* role */) const
 {
-    if (role == Qt::DisplayRole) {
-        if (Tile *tile = tileAt(index))
-            return tile->image();
-    }
-
+    // The tile images are drawn by the view straight from the tileset atlas,
+    // since handing them out here would copy each of them
     return QVariant();
 }
 
@@ -56,7 +56,8 @@ public:
 
     /**
      * Returns the data stored under the given <i>role</i> for the item
-     * referred to by the <i>index</i>.
+     * referred to by the <i>index</i>. There is none, since the view draws
+     * the tiles from the tileset atlas, see tileAt().
      */
     QVariant data(const QModelIndex &index,
                   int role = Qt::DisplayRole) const;
@@ -26,6 +26,7 @@
 #include "tmxmapwriter.h"
 #include "tile.h"
 #include "tileset.h"
+#include "tilesetmanager.h"
 #include "tilesetmodel.h"
 #include "utils.h"
 #include "zoomable.h"
@@ -69,14 +70,17 @@ void TileDelegate::paint(QPainter *painter,
                          const QStyleOptionViewItem &option,
                          const QModelIndex &index) const
 {
-    // Draw the tile image
-    const QVariant display = index.model()->data(index, Qt::DisplayRole);
-    const QPixmap tileImage = display.value<QPixmap>();
+    // Draw the tile image straight from the tileset atlas
+    const TilesetModel *m = static_cast<const TilesetModel*>(index.model());
+    const Tile *tile = m->tileAt(index);
+    if (!tile)
+        return;
 
     if (mTilesetView->zoomable()->smoothTransform())
         painter->setRenderHint(QPainter::SmoothPixmapTransform);
 
-    painter->drawPixmap(option.rect.adjusted(0, 0, -1, -1), tileImage);
+    painter->drawPixmap(option.rect.adjusted(0, 0, -1, -1),
+                        tile->atlas(), tile->atlasRect());
 
     // Overlay with highlight color when selected
     if (option.state & QStyle::State_Selected) {
@@ -126,7 +130,7 @@ private:
     void swap()
     {
         QString previousFileName = mTileset->fileName();
-        mTileset->setFileName(mFileName);
+        TilesetManager::instance()->setFileName(mTileset, mFileName);
         mFileName = previousFileName;
     }
 
@@ -71,7 +71,12 @@ Map *TmxMapReader::read(const QString &fileName)
 {
     mError.clear();
 
+    // Layers are only decoded once they are shown or edited, and tileset
+    // images are decoded in the background by the TilesetManager
     EditorMapReader reader;
+    reader.setLazyLoadingEnabled(true);
+    reader.setDeferredImageLoadingEnabled(true);
+    reader.setRegion(mRegion);
     Map *map = reader.readMap(fileName);
     if (!map)
         mError = reader.errorString();
@@ -100,6 +105,7 @@ Tileset *TmxMapReader::readTileset(const QString &fileName)
     mError.clear();
 
     EditorMapReader reader;
+    reader.setDeferredImageLoadingEnabled(true);
     Tileset *tileset = reader.readTileset(fileName);
     if (!tileset)
         mError = reader.errorString();
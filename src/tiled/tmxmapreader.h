@@ -24,6 +24,7 @@
 #include "mapreaderinterface.h"
 
 #include <QCoreApplication>
+#include <QRect>
 #include <QString>
 
 namespace Tiled {
@@ -33,7 +34,8 @@ class Tileset;
 namespace Internal {
 
 /**
- * A reader for Tiled's .tmx map format.
+ * A reader for Tiled's .tmx map format. Also reads maps in the binary .tmb
+ * map format.
  */
 class TmxMapReader : public MapReaderInterface
 {
@@ -55,12 +57,25 @@ public:
     QString nameFilter() const { return tr("Tiled map files (*.tmx)"); }
 
     bool supportsFile(const QString &fileName) const
-    { return fileName.endsWith(QLatin1String(".tmx"), Qt::CaseInsensitive); }
+    {
+        return fileName.endsWith(QLatin1String(".tmx"), Qt::CaseInsensitive)
+                || fileName.endsWith(QLatin1String(".tmb"),
+                                     Qt::CaseInsensitive);
+    }
 
     QString errorString() const { return mError; }
 
+    /**
+     * Sets the region of the map that read() loads, in tiles. A null
+     * rectangle, the default, loads the whole map.
+     *
+     * @see MapReader::setRegion()
+     */
+    void setRegion(const QRect &region) { mRegion = region; }
+
 private:
     QString mError;
+    QRect mRegion;
 };
 
 } // namespace Internal
@@ -34,9 +34,15 @@ bool TmxMapWriter::write(const Map *map, const QString &fileName)
 
     MapWriter writer;
     writer.setLayerDataFormat(prefs->layerDataFormat());
+    writer.setChunkedLayerDataEnabled(prefs->chunkedLayerData());
     writer.setDtdEnabled(prefs->dtdEnabled());
 
-    bool result = writer.writeMap(map, fileName);
+    bool result;
+    if (fileName.endsWith(QLatin1String(".tmb"), Qt::CaseInsensitive))
+        result = writer.writeBinaryMap(map, fileName);
+    else
+        result = writer.writeMap(map, fileName);
+
     if (!result)
         mError = writer.errorString();
     else
@@ -70,6 +76,7 @@ QByteArray TmxMapWriter::toByteArray(const Map *map)
 
     MapWriter writer;
     writer.setLayerDataFormat(MapWriter::Base64Zlib);
+    writer.setChunkedLayerDataEnabled(true);
     writer.writeMap(map, &buffer);
 
     return bytes;
@@ -33,7 +33,8 @@ class Tileset;
 namespace Internal {
 
 /**
- * A writer for Tiled's .tmx map format.
+ * A writer for Tiled's .tmx map format. Maps saved with the .tmb extension
+ * are written in the binary map format instead.
  */
 class TmxMapWriter : public MapWriterInterface
 {
@@ -20,8 +20,11 @@
 
 #include "tmxviewer.h"
 
+#include "tilesetcache.h"
+
 #include <QApplication>
 #include <QDebug>
+#include <QStringList>
 
 namespace {
 
@@ -34,6 +37,8 @@ struct CommandLineOptions {
     bool showHelp;
     bool showVersion;
     QString fileToOpen;
+    QString imageCacheDirectory;
+    QRect region;
 };
 
 } // anonymous namespace
@@ -45,7 +50,12 @@ static void showHelp()
             "Usage: tmxviewer [option] [file]\n\n"
             "Options:\n"
             "  -h --help    : Display this help\n"
-            "  -v --version : Display the version";
+            "  -v --version : Display the version\n"
+            "  -r --region x,y,width,height\n"
+            "               : Only load the given region of the map, in tiles\n"
+            "  --image-cache directory\n"
+            "               : Keep decoded tileset images in the given directory\n"
+            "                 to speed up later runs";
 }
 
 static void showVersion()
@@ -54,6 +64,28 @@ static void showVersion()
             << qPrintable(QApplication::applicationVersion());
 }
 
+/**
+ * Parses a region given as "x,y,width,height". Returns a null rectangle when
+ * the region is not valid.
+ */
+static QRect parseRegion(const QString &text)
+{
+    const QStringList parts = text.split(QLatin1Char(','));
+    if (parts.size() != 4)
+        return QRect();
+
+    int values[4];
+    for (int i = 0; i < 4; ++i) {
+        bool ok;
+        values[i] = parts.at(i).trimmed().toInt(&ok);
+        if (!ok)
+            return QRect();
+    }
+
+    const QRect region(values[0], values[1], values[2], values[3]);
+    return region.isValid() ? region : QRect();
+}
+
 static void parseCommandLineArguments(CommandLineOptions &options)
 {
     const QStringList arguments = QCoreApplication::arguments();
@@ -65,6 +97,21 @@ static void parseCommandLineArguments(CommandLineOptions &options)
         } else if (arg == QLatin1String("--version")
                 || arg == QLatin1String("-v")) {
             options.showVersion = true;
+        } else if (arg == QLatin1String("--region")
+                || arg == QLatin1String("-r")) {
+            if (i + 1 < arguments.size())
+                options.region = parseRegion(arguments.at(++i));
+            if (options.region.isNull()) {
+                qWarning() << "Invalid region, expected x,y,width,height";
+                options.showHelp = true;
+            }
+        } else if (arg == QLatin1String("--image-cache")) {
+            if (i + 1 < arguments.size()) {
+                options.imageCacheDirectory = arguments.at(++i);
+            } else {
+                qWarning() << "Missing image cache directory";
+                options.showHelp = true;
+            }
         } else if (arg.at(0) == QLatin1Char('-')) {
             qWarning() << "Unknown option" << arg;
             options.showHelp = true;
@@ -100,8 +147,13 @@ int main(int argc, char *argv[])
             || options.fileToOpen.isEmpty())
         return 0;
 
+    if (!options.imageCacheDirectory.isEmpty()) {
+        Tiled::TilesetCache::instance()->setDiskCacheDirectory(
+                    options.imageCacheDirectory);
+    }
+
     TmxViewer w;
-    w.viewMap(options.fileToOpen);
+    w.viewMap(options.fileToOpen, options.region);
     w.show();
 
     return a.exec();
@@ -169,7 +169,7 @@ TmxViewer::~TmxViewer()
     delete mRenderer;
 }
 
-void TmxViewer::viewMap(const QString &fileName)
+void TmxViewer::viewMap(const QString &fileName, const QRect &region)
 {
     delete mRenderer;
     mRenderer = 0;
@@ -178,6 +178,7 @@ void TmxViewer::viewMap(const QString &fileName)
     centerOn(0, 0);
 
     MapReader reader;
+    reader.setRegion(region);
     mMap = reader.readMap(fileName);
     if (!mMap)
         return; // TODO: Add error handling
@@ -193,4 +194,7 @@ void TmxViewer::viewMap(const QString &fileName)
     }
 
     mScene->addItem(new MapItem(mMap, mRenderer));
+
+    if (!region.isNull())
+        centerOn(mRenderer->boundingRect(region).center());
 }
@@ -22,6 +22,7 @@
 #define TMXVIEWER_H
 
 #include <QGraphicsView>
+#include <QRect>
 
 namespace Tiled {
 class Map;
@@ -36,7 +37,11 @@ public:
     explicit TmxViewer(QWidget *parent = 0);
     ~TmxViewer();
 
-    void viewMap(const QString &fileName);
+    /**
+     * Shows the map from \a fileName. When a \a region is given, only the
+     * tiles and objects within that region of the map are loaded.
+     */
+    void viewMap(const QString &fileName, const QRect &region = QRect());
 
 private:
     QGraphicsScene *mScene;
@@ -1,9 +1,17 @@
+#include "base64.h"
 #include "map.h"
 #include "mapobject.h"
 #include "objectgroup.h"
+#include "tile.h"
 #include "tilelayer.h"
+#include "tileset.h"
+#include "tilesetcache.h"
 #include "mapreader.h"
+#include "mapwriter.h"
 
+#include <QBuffer>
+#include <QDir>
+#include <QTemporaryFile>
 #include <QtTest/QtTest>
 
 using namespace Tiled;
@@ -14,6 +22,20 @@ class test_MapReader : public QObject
 
 private slots:
     void loadMap();
+    void base64Decoding();
+    void binaryRoundTrip();
+    void chunkedRoundTrip();
+    void lazyLoading();
+    void saveLazyMapOverSource();
+    void lazyTilesetReferences();
+    void loadRegion();
+    void loadRegionTiles();
+    void loadMappedFile();
+    void tilesetCache();
+    void tilesetCacheImageChange();
+    void diskCache();
+    void tilesetAtlas();
+    void deferredImageLoading();
 };
 
 void test_MapReader::loadMap()
@@ -53,5 +75,717 @@ void test_MapReader::loadMap()
     QCOMPARE(mapObject->height(), qreal(64) / qreal(map->tileHeight()));
 }
 
+void test_MapReader::base64Decoding()
+{
+    // Characters outside of the Latin-1 range that the vector code must
+    // not mistake for part of the alphabet, like U+0141 whose low byte is 'A'
+    const QChar wideChars[] = { QChar(0x0141), QChar(0x7F2B), QChar(0x8041),
+                                QChar(0xFF2F) };
+
+    qsrand(1);
+    for (int size = 0; size < 100; ++size) {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i)
+            data[i] = char(qrand());
+
+        // Padded and unpadded, which together cover every length modulo 16
+        QByteArray encoded = data.toBase64();
+        QByteArray unpadded = encoded;
+        while (unpadded.endsWith('='))
+            unpadded.chop(1);
+
+        foreach (const QByteArray &text, QList<QByteArray>() << encoded
+                                                             << unpadded) {
+            QCOMPARE(Tiled::decodeBase64(text.constData(), text.size()), data);
+            const QString string = QString::fromLatin1(text);
+            QCOMPARE(Tiled::decodeBase64(string.unicode(), string.size()),
+                     data);
+        }
+
+        // Whitespace, padding and other characters outside of the alphabet
+        // are skipped wherever they are
+        QByteArray noisy;
+        QString noisyString;
+        for (int i = 0; i < encoded.size(); ++i) {
+            noisy += encoded.at(i);
+            noisyString += QLatin1Char(encoded.at(i));
+            if (i % 7 == 3) {
+                noisy += "\n  ";
+                noisyString += QLatin1String("\n  ");
+            }
+            if (i % 11 == 5) {
+                noisy += '=';
+                noisyString += QLatin1Char('=');
+            }
+            if (i % 13 == 9) {
+                noisy += '\xC1';
+                noisyString += QLatin1Char('\xC1');
+            }
+            if (i % 17 == 12)
+                noisyString += wideChars[i % 4];
+        }
+
+        const QByteArray expected = QByteArray::fromBase64(noisy);
+        QCOMPARE(Tiled::decodeBase64(noisy.constData(), noisy.size()),
+                 expected);
+        QCOMPARE(Tiled::decodeBase64(noisyString.unicode(),
+                                     noisyString.size()), expected);
+    }
+}
+
+static QByteArray toTmx(const Map *map)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    MapWriter().writeMap(map, &buffer);
+    return data;
+}
+
+void test_MapReader::binaryRoundTrip()
+{
+    MapReader reader;
+    Map *map = reader.readMap("data/mapobject.tmx");
+    QVERIFY(map);
+
+    QByteArray binary;
+    QBuffer buffer(&binary);
+    buffer.open(QIODevice::WriteOnly);
+    MapWriter().writeBinaryMap(map, &buffer);
+    buffer.close();
+
+    // Binary maps are recognized by readMap()
+    buffer.open(QIODevice::ReadOnly);
+    Map *binaryMap = reader.readMap(&buffer);
+
+    QVERIFY(binaryMap);
+    QCOMPARE(binaryMap->layerCount(), 2);
+    QCOMPARE(binaryMap->width(), 100);
+    QCOMPARE(binaryMap->height(), 80);
+
+    ObjectGroup *objectGroup = dynamic_cast<ObjectGroup*>(binaryMap->layerAt(1));
+
+    QVERIFY(objectGroup);
+    QCOMPARE(objectGroup->objects().count(), 1);
+    QCOMPARE(objectGroup->objects().at(0)->bounds(),
+             map->layerAt(1)->asObjectGroup()->objects().at(0)->bounds());
+
+    // Converting back to TMX gives the same file
+    QCOMPARE(toTmx(binaryMap), toTmx(map));
+
+    delete binaryMap;
+    delete map;
+}
+
+/**
+ * Saves an image for a tileset of two 32x32 tiles, filled with \a color, to
+ * \a file. Returns the image, or a null image when it could not be saved.
+ */
+static QImage createTilesetImage(QTemporaryFile *file,
+                                 QRgb color = 0xff00ff00)
+{
+    QImage image(64, 32, QImage::Format_ARGB32);
+    image.fill(color);
+    if (!file->open() || !image.save(file, "PNG"))
+        return QImage();
+    file->close();
+    return image;
+}
+
+/**
+ * Creates a tileset of 32x32 tiles from the \a image that was saved to
+ * \a fileName. Returns 0 when the tiles could not be created.
+ */
+static Tileset *createTileset(const QString &name, const QImage &image,
+                              const QString &fileName)
+{
+    Tileset *tileset = new Tileset(name, 32, 32);
+    if (!tileset->loadFromImage(image, fileName)) {
+        delete tileset;
+        return 0;
+    }
+    return tileset;
+}
+
+void test_MapReader::chunkedRoundTrip()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    Tileset *tileset = createTileset(QLatin1String("Tiles"), image,
+                                     imageFile.fileName());
+    QVERIFY(tileset);
+
+    Map map(Map::Orthogonal, QRect(0, 0, 45, 37), 32, 32);
+    map.addTileset(tileset);
+
+    // A layer whose bounds don't end on a chunk boundary
+    TileLayer *unaligned = new TileLayer(QLatin1String("Unaligned"), 0, 0,
+                                         QRect(0, 0, 45, 37));
+    unaligned->setTile(0, 0, tileset->tileAt(0));
+    unaligned->setTile(33, 5, tileset->tileAt(1));
+    unaligned->setTile(44, 36, tileset->tileAt(1));
+    map.addLayer(unaligned);
+
+    // A layer with chunks at negative coordinates
+    TileLayer *negative = new TileLayer(QLatin1String("Negative"), 0, 0,
+                                        QRect(0, 0, 45, 37));
+    negative->setTile(-1, -1, tileset->tileAt(0));
+    negative->setTile(-40, -33, tileset->tileAt(1));
+    negative->setTile(-33, 10, tileset->tileAt(1));
+    negative->setTile(20, -65, tileset->tileAt(0));
+    map.addLayer(negative);
+
+    QTemporaryFile mapFile;
+    QVERIFY(mapFile.open());
+    mapFile.close();
+
+    const MapWriter::LayerDataFormat formats[] = {
+        MapWriter::Base64Zlib, MapWriter::CSV, MapWriter::XML
+    };
+
+    for (int i = 0; i < 3; ++i) {
+        MapWriter writer;
+        writer.setLayerDataFormat(formats[i]);
+        writer.setChunkedLayerDataEnabled(true);
+        QVERIFY(writer.writeMap(&map, mapFile.fileName()));
+
+        QVERIFY(mapFile.open());
+        QVERIFY(mapFile.readAll().contains("<chunk"));
+        mapFile.close();
+
+        MapReader reader;
+        Map *readMap = reader.readMap(mapFile.fileName());
+        QVERIFY(readMap);
+        QCOMPARE(readMap->layerCount(), 2);
+
+        for (int l = 0; l < 2; ++l) {
+            const TileLayer *written = map.layerAt(l)->asTileLayer();
+            const TileLayer *read = readMap->layerAt(l)->asTileLayer();
+            QCOMPARE(read->bounds(), written->bounds());
+            QCOMPARE(read->region(), written->region());
+
+            const QRect bounds = written->bounds();
+            for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+                for (int x = bounds.left(); x <= bounds.right(); ++x) {
+                    const Tile *a = written->tileAt(x, y);
+                    const Tile *b = read->tileAt(x, y);
+                    QCOMPARE(b ? b->id() : -1, a ? a->id() : -1);
+                }
+            }
+        }
+
+        qDeleteAll(readMap->tilesets());
+        delete readMap;
+    }
+
+    delete tileset;
+}
+
+void test_MapReader::lazyLoading()
+{
+    MapReader reader;
+    Map *map = reader.readMap("data/mapobject.tmx");
+    QVERIFY(map);
+
+    reader.setLazyLoadingEnabled(true);
+    Map *lazyMap = reader.readMap("data/mapobject.tmx");
+    QVERIFY(lazyMap);
+
+    TileLayer *tileLayer = lazyMap->layerAt(0)->asTileLayer();
+    QVERIFY(!tileLayer->isLoaded());
+    QCOMPARE(tileLayer->width(), 100);
+    QCOMPARE(tileLayer->height(), 80);
+    const QRect bounds = tileLayer->bounds();
+
+    // Looking at the tiles loads the layer, which leaves its bounds alone
+    QCOMPARE(toTmx(lazyMap), toTmx(map));
+    QVERIFY(tileLayer->isLoaded());
+    QCOMPARE(tileLayer->bounds(), bounds);
+
+    delete lazyMap;
+    delete map;
+}
+
+void test_MapReader::saveLazyMapOverSource()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    Tileset *tileset = createTileset(QLatin1String("Tiles"), image,
+                                     imageFile.fileName());
+    QVERIFY(tileset);
+
+    Map map(Map::Orthogonal, QRect(0, 0, 40, 30), 32, 32);
+    map.addTileset(tileset);
+    TileLayer *hidden = new TileLayer(QLatin1String("Hidden"), 0, 0,
+                                      QRect(0, 0, 40, 30));
+    for (int i = 0; i < 40; ++i)
+        hidden->setTile(i, (i * 7) % 30, tileset->tileAt(i % 2));
+    hidden->setVisible(false);
+    map.addLayer(hidden);
+
+    QTemporaryFile mapFile;
+    QVERIFY(mapFile.open());
+    mapFile.close();
+
+    for (int binary = 0; binary < 2; ++binary) {
+        MapWriter writer;
+        QVERIFY(binary ? writer.writeBinaryMap(&map, mapFile.fileName())
+                       : writer.writeMap(&map, mapFile.fileName()));
+
+        MapReader reader;
+        reader.setLazyLoadingEnabled(true);
+        Map *lazyMap = reader.readMap(mapFile.fileName());
+        QVERIFY(lazyMap);
+        QVERIFY(!lazyMap->layerAt(0)->asTileLayer()->isLoaded());
+
+        // Saving loads the hidden layer before the file is truncated
+        QVERIFY(binary ? writer.writeBinaryMap(lazyMap, mapFile.fileName())
+                       : writer.writeMap(lazyMap, mapFile.fileName()));
+
+        Map *savedMap = MapReader().readMap(mapFile.fileName());
+        QVERIFY(savedMap);
+        QCOMPARE(toTmx(savedMap), toTmx(&map));
+
+        qDeleteAll(lazyMap->tilesets());
+        qDeleteAll(savedMap->tilesets());
+        delete lazyMap;
+        delete savedMap;
+    }
+
+    delete tileset;
+}
+
+void test_MapReader::lazyTilesetReferences()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    // Each layer uses one tileset, and the last tileset isn't used at all
+    Map map(Map::Orthogonal, QRect(0, 0, 40, 30), 32, 32);
+    for (int i = 0; i < 3; ++i) {
+        Tileset *tileset = createTileset(QString::number(i), image,
+                                         imageFile.fileName());
+        QVERIFY(tileset);
+        map.addTileset(tileset);
+    }
+    for (int i = 0; i < 2; ++i) {
+        TileLayer *layer = new TileLayer(QString::number(i), 0, 0,
+                                         QRect(0, 0, 40, 30));
+        for (int x = 0; x < 40; ++x)
+            layer->setTile(x, (x * 7) % 30, map.tilesets().at(i)->tileAt(1));
+        map.addLayer(layer);
+    }
+
+    QTemporaryFile mapFile;
+    QVERIFY(mapFile.open());
+    mapFile.close();
+    QVERIFY(MapWriter().writeMap(&map, mapFile.fileName()));
+
+    MapReader reader;
+    reader.setLazyLoadingEnabled(true);
+    Map *lazyMap = reader.readMap(mapFile.fileName());
+    QVERIFY(lazyMap);
+    TileLayer *first = lazyMap->layerAt(0)->asTileLayer();
+    TileLayer *second = lazyMap->layerAt(1)->asTileLayer();
+
+    // Until they are loaded, the layers count as using every tileset
+    QVERIFY(lazyMap->isTilesetUsed(lazyMap->tilesets().at(0)));
+    QVERIFY(lazyMap->isTilesetUsed(lazyMap->tilesets().at(2)));
+    QCOMPARE(second->usedTilesets().size(), 3);
+    QVERIFY(!first->isLoaded());
+    QVERIFY(!second->isLoaded());
+
+    // A clone loads its layers on its own
+    Map *clone = lazyMap->clone();
+    QVERIFY(!first->isLoaded());
+    QVERIFY(!clone->layerAt(0)->asTileLayer()->isLoaded());
+    QCOMPARE(toTmx(clone), toTmx(&map));
+    QVERIFY(!first->isLoaded());
+    delete clone;
+
+    // Once loaded, the layers know the tilesets they really use
+    Tileset *replacement = lazyMap->tilesets().at(2)->clone();
+    Tileset *replaced = lazyMap->tilesets().at(1);
+    lazyMap->replaceTileset(replaced, replacement);
+    QVERIFY(first->isLoaded());
+    QVERIFY(second->isLoaded());
+    QCOMPARE(second->tileAt(0, 0), replacement->tileAt(1));
+    QCOMPARE(second->usedTilesets().size(), 1);
+    QVERIFY(!lazyMap->isTilesetUsed(lazyMap->tilesets().at(2)));
+
+    qDeleteAll(lazyMap->tilesets());
+    delete replaced;
+    delete lazyMap;
+    qDeleteAll(map.tilesets());
+}
+
+void test_MapReader::loadRegion()
+{
+    MapReader reader;
+    reader.setRegion(QRect(0, 0, 5, 5));
+    Map *map = reader.readMap("data/mapobject.tmx");
+
+    // The map keeps its size, but the object is outside of the region
+    QVERIFY(map);
+    QCOMPARE(map->width(), 100);
+    QCOMPARE(map->height(), 80);
+    QCOMPARE(map->layerAt(0)->width(), 100);
+    QCOMPARE(map->layerAt(1)->asObjectGroup()->objects().count(), 0);
+    delete map;
+
+    reader.setRegion(QRect(5, 5, 10, 10));
+    map = reader.readMap("data/mapobject.tmx");
+
+    QVERIFY(map);
+    QCOMPARE(map->layerAt(1)->asObjectGroup()->objects().count(), 1);
+    delete map;
+}
+
+/**
+ * Returns whether \a read has the tiles of \a written within \a region and
+ * no tiles anywhere else.
+ */
+static bool hasTilesInRegion(const TileLayer *read, const TileLayer *written,
+                             const QRect &region)
+{
+    const QRect bounds = read->bounds().united(written->bounds());
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        for (int x = bounds.left(); x <= bounds.right(); ++x) {
+            const Tile *expected =
+                    region.contains(x, y) ? written->tileAt(x, y) : 0;
+            const Tile *tile = read->tileAt(x, y);
+            if ((tile ? tile->id() : -1) != (expected ? expected->id() : -1))
+                return false;
+        }
+    }
+    return true;
+}
+
+void test_MapReader::loadRegionTiles()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    Tileset *tileset = createTileset(QLatin1String("Tiles"), image,
+                                     imageFile.fileName());
+    QVERIFY(tileset);
+
+    // A layer that doesn't end on a chunk boundary, with some tiles empty
+    Map map(Map::Orthogonal, QRect(0, 0, 45, 37), 32, 32);
+    map.addTileset(tileset);
+    TileLayer *tileLayer = new TileLayer(QLatin1String("Tiles"), 0, 0,
+                                         QRect(0, 0, 45, 37));
+    for (int y = 0; y < 37; ++y)
+        for (int x = 0; x < 45; ++x)
+            if ((x * 7 + y * 3) % 5 != 0)
+                tileLayer->setTile(x, y, tileset->tileAt((x + y) % 2));
+    map.addLayer(tileLayer);
+
+    // The first region stops above the last row and leaves out the bottom
+    // chunks, the second one ends on the last row
+    const QRect regions[] = {
+        QRect(10, 8, 30, 20),
+        QRect(3, 30, 40, 7)
+    };
+
+    enum Storage { Tmx, ChunkedTmx, Binary };
+
+    QTemporaryFile mapFile;
+    QVERIFY(mapFile.open());
+    mapFile.close();
+
+    for (int format = MapWriter::XML; format <= MapWriter::CSV; ++format) {
+        for (int storage = Tmx; storage <= Binary; ++storage) {
+            MapWriter writer;
+            writer.setLayerDataFormat(MapWriter::LayerDataFormat(format));
+            writer.setChunkedLayerDataEnabled(storage == ChunkedTmx);
+            if (storage == Binary)
+                QVERIFY(writer.writeBinaryMap(&map, mapFile.fileName()));
+            else
+                QVERIFY(writer.writeMap(&map, mapFile.fileName()));
+
+            for (int r = 0; r < 2; ++r) {
+                MapReader reader;
+                reader.setRegion(regions[r]);
+                Map *readMap = reader.readMap(mapFile.fileName());
+                QVERIFY(readMap);
+                QVERIFY(hasTilesInRegion(readMap->layerAt(0)->asTileLayer(),
+                                         tileLayer, regions[r]));
+                qDeleteAll(readMap->tilesets());
+                delete readMap;
+            }
+        }
+    }
+
+    // Values past the end of CSV data are only noticed when the region
+    // reaches the last row
+    MapWriter writer;
+    writer.setLayerDataFormat(MapWriter::CSV);
+    QVERIFY(writer.writeMap(&map, mapFile.fileName()));
+    QVERIFY(mapFile.open());
+    QByteArray data = mapFile.readAll();
+    mapFile.close();
+
+    data.replace("</data>", ",1</data>");
+    QVERIFY(mapFile.open());
+    mapFile.resize(0);
+    mapFile.write(data);
+    mapFile.close();
+
+    MapReader reader;
+    reader.setRegion(regions[0]);
+    Map *readMap = reader.readMap(mapFile.fileName());
+    QVERIFY(readMap);
+    QVERIFY(hasTilesInRegion(readMap->layerAt(0)->asTileLayer(),
+                             tileLayer, regions[0]));
+    qDeleteAll(readMap->tilesets());
+    delete readMap;
+
+    reader.setRegion(regions[1]);
+    QVERIFY(!reader.readMap(mapFile.fileName()));
+
+    // Chunks outside of the region are not decoded, so their data is
+    // never found to be corrupt
+    writer.setLayerDataFormat(MapWriter::Base64Zlib);
+    writer.setChunkedLayerDataEnabled(true);
+    QVERIFY(writer.writeMap(&map, mapFile.fileName()));
+    QVERIFY(mapFile.open());
+    data = mapFile.readAll();
+    mapFile.close();
+
+    const int chunk = data.indexOf(" y=\"32\"");
+    QVERIFY(chunk != -1);
+    const int start = data.indexOf('>', chunk) + 1;
+    const int end = data.indexOf("</chunk>", start);
+    data.replace(start, end - start, "AAAA");
+    QVERIFY(mapFile.open());
+    mapFile.resize(0);
+    mapFile.write(data);
+    mapFile.close();
+
+    reader.setRegion(regions[0]);
+    readMap = reader.readMap(mapFile.fileName());
+    QVERIFY(readMap);
+    QVERIFY(hasTilesInRegion(readMap->layerAt(0)->asTileLayer(),
+                             tileLayer, regions[0]));
+    qDeleteAll(readMap->tilesets());
+    delete readMap;
+
+    reader.setRegion(regions[1]);
+    QVERIFY(!reader.readMap(mapFile.fileName()));
+
+    delete tileset;
+}
+
+void test_MapReader::loadMappedFile()
+{
+    QFile file("data/mapobject.tmx");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    // The layer data taken from the mapping matches the text of the reader
+    MapReader reader;
+    Map *map = reader.readMap(&buffer, "data");
+    QVERIFY(map);
+    buffer.close();
+
+    Map *mappedMap = reader.readMap("data/mapobject.tmx");
+    QVERIFY(mappedMap);
+    QCOMPARE(toTmx(mappedMap), toTmx(map));
+    delete mappedMap;
+
+    // Files with Windows line endings are not opened in text mode
+    data.replace("\n", "\r\n");
+    QTemporaryFile tempFile;
+    QVERIFY(tempFile.open());
+    tempFile.write(data);
+    tempFile.close();
+
+    mappedMap = reader.readMap(tempFile.fileName());
+    QVERIFY(mappedMap);
+    QCOMPARE(toTmx(mappedMap), toTmx(map));
+
+    delete mappedMap;
+    delete map;
+}
+
+void test_MapReader::tilesetCache()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    TilesetCache cache;
+    QCOMPARE(cache.image(imageFile.fileName()), image);
+    QCOMPARE(cache.image(imageFile.fileName()), image);
+    QCOMPARE(cache.missCount(), 1);
+    QCOMPARE(cache.hitCount(), 1);
+    QCOMPARE(cache.memoryUsage(), qint64(image.byteCount()));
+
+    // Images larger than the budget are not kept
+    cache.setMemoryBudget(1024);
+    QCOMPARE(cache.memoryUsage(), qint64(0));
+    QCOMPARE(cache.image(imageFile.fileName()), image);
+    QCOMPARE(cache.missCount(), 2);
+}
+
+void test_MapReader::tilesetCacheImageChange()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    Tileset *source = createTileset(QLatin1String("Tiles"), image,
+                                    imageFile.fileName());
+    QVERIFY(source);
+
+    QTemporaryFile tilesetFile;
+    QVERIFY(tilesetFile.open());
+    tilesetFile.close();
+    QVERIFY(MapWriter().writeTileset(source, tilesetFile.fileName()));
+    delete source;
+
+    TilesetCache cache;
+    QString error;
+    Tileset *tileset = cache.tileset(tilesetFile.fileName(), &error);
+    QVERIFY(tileset);
+    QCOMPARE(tileset->tileCount(), 2);
+    delete tileset;
+
+    // Changing only the image still reads the tileset again
+    QImage wider(96, 32, QImage::Format_ARGB32);
+    wider.fill(0xff0000ff);
+    QVERIFY(wider.save(imageFile.fileName(), "PNG"));
+
+    tileset = cache.tileset(tilesetFile.fileName(), &error);
+    QVERIFY(tileset);
+    QCOMPARE(tileset->tileCount(), 3);
+    QCOMPARE(cache.hitCount(), 0);
+    delete tileset;
+}
+
+void test_MapReader::diskCache()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile, 0x80402010);
+    QVERIFY(!image.isNull());
+
+    const QString directory =
+            QDir::temp().filePath(QLatin1String("test_mapreader_cache"));
+    const QImage premultiplied =
+            image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    // The first cache decodes the image and stores it on disk
+    TilesetCache first;
+    first.setDiskCacheDirectory(directory);
+    QCOMPARE(first.image(imageFile.fileName()), premultiplied);
+    QCOMPARE(first.diskHitCount(), 0);
+
+    // A later one reads it back instead of decoding it
+    TilesetCache second;
+    second.setDiskCacheDirectory(directory);
+    QCOMPARE(second.image(imageFile.fileName()), premultiplied);
+    QCOMPARE(second.diskHitCount(), 1);
+
+    // Changing the file invalidates its entry, and without any budget the
+    // new one isn't kept
+    QImage changed(32, 32, QImage::Format_ARGB32);
+    changed.fill(0xff00ff00);
+    QVERIFY(changed.save(imageFile.fileName(), "PNG"));
+
+    TilesetCache third;
+    third.setDiskCacheDirectory(directory);
+    third.setDiskCacheBudget(0);
+    QCOMPARE(third.image(imageFile.fileName()),
+             changed.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+    QCOMPARE(third.diskHitCount(), 0);
+    QVERIFY(QDir(directory).entryList(QDir::Files).isEmpty());
+
+    // Reloading replaces the stored image even when the file can't be told
+    // apart from the one it was made for
+    QVERIFY(image.save(imageFile.fileName(), "PNG"));
+    QCOMPARE(first.image(imageFile.fileName()), premultiplied);
+    QVERIFY(changed.save(imageFile.fileName(), "PNG"));
+    const QImage reloaded = first.reloadImage(imageFile.fileName());
+    QCOMPARE(reloaded,
+             changed.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+    QCOMPARE(first.image(imageFile.fileName()), reloaded);
+
+    TilesetCache fourth;
+    fourth.setDiskCacheDirectory(directory);
+    QCOMPARE(fourth.image(imageFile.fileName()), reloaded);
+    QCOMPARE(fourth.diskHitCount(), 1);
+
+    foreach (const QString &entry, QDir(directory).entryList(QDir::Files))
+        QFile::remove(QDir(directory).filePath(entry));
+    QDir().rmdir(directory);
+}
+
+void test_MapReader::tilesetAtlas()
+{
+    QImage image(64, 32, QImage::Format_RGB32);
+    image.fill(0xffff00ff);
+    image.setPixel(40, 0, 0xff00ff00);
+
+    const QColor transparentColor(0xff, 0x00, 0xff);
+    QCOMPARE(Tileset::atlasImage(image, transparentColor).format(),
+             QImage::Format_ARGB32_Premultiplied);
+
+    Tileset tileset(QLatin1String("Atlas"), 32, 32);
+    tileset.setTransparentColor(transparentColor);
+    QVERIFY(tileset.loadFromImage(image, QLatin1String("atlas.png")));
+    QCOMPARE(tileset.tileCount(), 2);
+
+    // The tiles share one pixmap with the transparent color made transparent
+    const Tile *tile = tileset.tileAt(1);
+    QCOMPARE(tile->atlas().cacheKey(), tileset.tileAt(0)->atlas().cacheKey());
+    QCOMPARE(tile->atlasRect(), QRect(32, 0, 32, 32));
+
+    const QImage tileImage = tile->image().toImage();
+    QCOMPARE(tileImage.size(), QSize(32, 32));
+    QCOMPARE(qAlpha(tileImage.pixel(0, 1)), 0);
+    QCOMPARE(tileImage.pixel(8, 0), 0xff00ff00);
+}
+
+void test_MapReader::deferredImageLoading()
+{
+    QTemporaryFile imageFile;
+    const QImage image = createTilesetImage(&imageFile);
+    QVERIFY(!image.isNull());
+
+    QByteArray tsx = "<tileset name=\"Deferred\" tilewidth=\"32\""
+                     " tileheight=\"32\"><image source=\"";
+    tsx += imageFile.fileName().toUtf8();
+    tsx += "\"/></tileset>";
+    QBuffer buffer(&tsx);
+    buffer.open(QIODevice::ReadOnly);
+
+    MapReader reader;
+    reader.setDeferredImageLoadingEnabled(true);
+    Tileset *tileset = reader.readTileset(&buffer);
+
+    // The tiles are there, but the image is left to be loaded
+    QVERIFY(tileset);
+    QVERIFY(tileset->hasPlaceholderTiles());
+    QCOMPARE(tileset->tileCount(), 2);
+    QCOMPARE(tileset->tileAt(1)->size(), QSize(32, 32));
+
+    const QImage atlasImage = Tileset::atlasImage(QImage(imageFile.fileName()),
+                                                  tileset->transparentColor());
+    QVERIFY(tileset->loadFromAtlasImage(atlasImage, imageFile.fileName()));
+    QVERIFY(!tileset->hasPlaceholderTiles());
+    QCOMPARE(tileset->tileAt(1)->atlasRect(), QRect(32, 0, 32, 32));
+
+    delete tileset;
+}
+
 QTEST_MAIN(test_MapReader)
 #include "test_mapreader.moc"
@@ -0,0 +1,327 @@
+#include "map.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * The number of tiles along each side of the chunks that tile layers keep
+ * their tiles in.
+ */
+static const int ChunkSize = 32;
+
+class test_TileLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void paletteEncoding();
+    void tilesetReferenceCounts();
+    void cloneSharesChunks();
+    void bulkBlits();
+};
+
+/**
+ * Returns the tiles within \a rect, row by row.
+ */
+static QVector<Tile*> tilesIn(const TileLayer *layer, const QRect &rect)
+{
+    QVector<Tile*> tiles;
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        for (int x = rect.left(); x <= rect.right(); ++x)
+            tiles.append(layer->tileAt(x, y));
+    return tiles;
+}
+
+/**
+ * Creates a tileset of two 32x32 tiles.
+ */
+static Tileset *createTileset(const QString &name)
+{
+    QImage image(64, 32, QImage::Format_ARGB32);
+    image.fill(0xff00ff00);
+
+    Tileset *tileset = new Tileset(name, 32, 32);
+    tileset->loadFromImage(image, name + QLatin1String(".png"));
+    return tileset;
+}
+
+/**
+ * Copies \a rect from \a source one cell at a time. This is what copyRect()
+ * and mergeRect() are compared against.
+ */
+static void copyCells(TileLayer *layer, const QRect &rect,
+                      const TileLayer *source, const QPoint &sourcePos,
+                      bool skipEmpty)
+{
+    const QVector<Tile*> tiles = tilesIn(source, QRect(sourcePos, rect.size()));
+    int i = 0;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        for (int x = rect.left(); x <= rect.right(); ++x, ++i) {
+            if (!skipEmpty || tiles.at(i))
+                layer->setTile(x, y, tiles.at(i));
+        }
+    }
+}
+
+void test_TileLayer::paletteEncoding()
+{
+    // A tileset with one tile for every cell of a chunk
+    QImage image(ChunkSize, ChunkSize, QImage::Format_ARGB32);
+    image.fill(0xff00ff00);
+    Tileset tileset(QLatin1String("Tiles"), 1, 1);
+    QVERIFY(tileset.loadFromImage(image, QLatin1String("tiles.png")));
+    QCOMPARE(tileset.tileCount(), ChunkSize * ChunkSize);
+
+    const QRect chunk(0, 0, ChunkSize, ChunkSize);
+
+    for (int compact = 0; compact < 2; ++compact) {
+        TileLayer::setCompactStorage(compact);
+
+        // Giving every cell its own tile widens the palette indices to 16
+        // bits after 255 tiles, and falls back to plain pointers later on
+        TileLayer layer(QLatin1String("Layer"), 0, 0, chunk);
+        QVector<Tile*> expected(tileset.tileCount());
+        for (int i = 0; i < tileset.tileCount(); ++i) {
+            layer.setTile(i % ChunkSize, i / ChunkSize, tileset.tileAt(i));
+            expected[i] = tileset.tileAt(i);
+            if (i == 254 || i == 255 || i == 511)
+                QCOMPARE(tilesIn(&layer, chunk), expected);
+        }
+        QCOMPARE(tilesIn(&layer, chunk), expected);
+        QCOMPARE(layer.region(), QRegion(chunk));
+
+        // Tiles that are no longer used free their palette entries, which
+        // are then taken by new tiles
+        TileLayer compacted(QLatin1String("Compacted"), 0, 0, chunk);
+        expected.fill(0);
+        for (int i = 0; i < 255; ++i) {
+            compacted.setTile(i % ChunkSize, i / ChunkSize, tileset.tileAt(i));
+            expected[i] = tileset.tileAt(i);
+        }
+        for (int i = 0; i < 200; ++i) {
+            compacted.setTile(i % ChunkSize, i / ChunkSize, 0);
+            expected[i] = 0;
+        }
+        for (int i = 0; i < 100; ++i) {
+            compacted.setTile(i % ChunkSize, i / ChunkSize,
+                              tileset.tileAt(300 + i));
+            expected[i] = tileset.tileAt(300 + i);
+        }
+        QCOMPARE(tilesIn(&compacted, chunk), expected);
+
+        // Changing a clone leaves the palette of the original alone
+        TileLayer *clone = static_cast<TileLayer*>(compacted.clone());
+        clone->setTile(0, 0, tileset.tileAt(1000));
+        QCOMPARE(compacted.tileAt(0, 0), tileset.tileAt(300));
+        QCOMPARE(clone->tileAt(0, 0), tileset.tileAt(1000));
+        delete clone;
+    }
+
+    TileLayer::setCompactStorage(true);
+}
+
+void test_TileLayer::tilesetReferenceCounts()
+{
+    Map map(Map::Orthogonal, QRect(0, 0, 100, 100), 32, 32);
+    Tileset *first = createTileset(QLatin1String("First"));
+    Tileset *second = createTileset(QLatin1String("Second"));
+    map.addTileset(first);
+    map.addTileset(second);
+
+    TileLayer *layer = new TileLayer(QLatin1String("Layer"), 0, 0,
+                                     QRect(0, 0, 100, 100));
+    map.addLayer(layer);
+
+    // Bulk writes from both tilesets, overlapping in the middle
+    TileLayer stamp(QLatin1String("Stamp"), 0, 0, QRect(0, 0, 2, 1));
+    stamp.setTile(0, 0, first->tileAt(0));
+    stamp.setTile(1, 0, first->tileAt(1));
+    layer->fillStamp(QRect(0, 0, 60, 60), &stamp, QPoint(0, 0));
+
+    TileLayer source(QLatin1String("Source"), 0, 0, QRect(0, 0, 50, 50));
+    source.fillStamp(source.bounds(), &stamp, QPoint(0, 0));
+    source.replaceReferencesToTileset(first, second);
+    layer->copyRect(QRect(40, 40, 50, 50), &source, QPoint(0, 0));
+
+    QCOMPARE(layer->usedTilesets().size(), 2);
+    QVERIFY(layer->referencesTileset(first));
+    QVERIFY(layer->referencesTileset(second));
+    QCOMPARE(layer->tilesetReferences(first),
+             QRegion(0, 0, 60, 60) - QRegion(40, 40, 20, 20));
+    QCOMPARE(layer->tilesetReferences(second), QRegion(40, 40, 50, 50));
+
+    // Writing the same tile again doesn't count twice
+    layer->setTile(95, 95, first->tileAt(0));
+    layer->setTile(95, 95, first->tileAt(0));
+    layer->clearRect(QRect(0, 0, 60, 40));
+    layer->clearRect(QRect(0, 40, 40, 20));
+    QVERIFY(layer->referencesTileset(first));
+    layer->setTile(95, 95, 0);
+    QVERIFY(!layer->referencesTileset(first));
+    QVERIFY(!map.isTilesetUsed(first));
+    QVERIFY(map.isTilesetUsed(second));
+
+    // Replacing moves the references over to the other tileset
+    layer->replaceReferencesToTileset(second, first);
+    QVERIFY(layer->referencesTileset(first));
+    QVERIFY(!layer->referencesTileset(second));
+    QCOMPARE(layer->usedTilesets().size(), 1);
+    QCOMPARE(layer->tilesetReferences(first), QRegion(40, 40, 50, 50));
+
+    layer->removeReferencesToTileset(first);
+    QVERIFY(layer->usedTilesets().isEmpty());
+    QVERIFY(!map.isTilesetUsed(first));
+    QVERIFY(layer->region().isEmpty());
+
+    qDeleteAll(map.tilesets());
+}
+
+void test_TileLayer::cloneSharesChunks()
+{
+    Map map(Map::Orthogonal, QRect(0, 0, 100, 100), 32, 32);
+    Tileset *first = createTileset(QLatin1String("First"));
+    Tileset *second = createTileset(QLatin1String("Second"));
+    map.addTileset(first);
+    map.addTileset(second);
+
+    TileLayer *layer = new TileLayer(QLatin1String("Layer"), 0, 0,
+                                     QRect(0, 0, 100, 100));
+    for (int i = 0; i < 2000; ++i)
+        layer->setTile((i * 37) % 140 - 40, (i * 53) % 130 - 30,
+                       first->tileAt(i % 2));
+    map.addLayer(layer);
+
+    const QRect area = layer->bounds();
+    const QVector<Tile*> original = tilesIn(layer, area);
+
+    // Changes to the clone leave the original alone
+    Map *clone = map.clone();
+    TileLayer *cloned = clone->layerAt(0)->asTileLayer();
+    QCOMPARE(tilesIn(cloned, area), original);
+
+    TileLayer stamp(QLatin1String("Stamp"), 0, 0, QRect(0, 0, 1, 1));
+    stamp.setTile(0, 0, second->tileAt(1));
+    cloned->setTile(-40, -30, second->tileAt(0));
+    cloned->fillStamp(QRect(10, 10, 40, 40), &stamp, QPoint(0, 0));
+    cloned->clearRect(QRect(64, 0, 32, 32));
+    cloned->copyRect(QRect(-32, -32, 64, 64), cloned, QPoint(32, 32));
+    cloned->removeReferencesToTileset(first);
+
+    QCOMPARE(tilesIn(layer, area), original);
+    QVERIFY(layer->referencesTileset(first));
+    QVERIFY(!layer->referencesTileset(second));
+    QVERIFY(!cloned->referencesTileset(first));
+    QVERIFY(cloned->referencesTileset(second));
+
+    // And the other way around
+    const QVector<Tile*> changed = tilesIn(cloned, area);
+    layer->clearRect(area);
+    layer->setTile(0, 0, first->tileAt(1));
+    QCOMPARE(tilesIn(cloned, area), changed);
+    QVERIFY(!cloned->referencesTileset(first));
+
+    delete clone;
+    qDeleteAll(map.tilesets());
+}
+
+void test_TileLayer::bulkBlits()
+{
+    Tileset *first = createTileset(QLatin1String("First"));
+    Tileset *second = createTileset(QLatin1String("Second"));
+
+    // Every blit is repeated with setTile() on the expected layer
+    TileLayer source(QLatin1String("Source"), 0, 0, QRect(0, 0, 100, 100));
+    TileLayer blitted(QLatin1String("Blitted"), 0, 0, QRect(0, 0, 100, 100));
+    TileLayer expected(QLatin1String("Expected"), 0, 0,
+                       QRect(0, 0, 100, 100));
+    for (int i = 0; i < 3000; ++i) {
+        const int x = (i * 37) % 150 - 50;
+        const int y = (i * 53) % 140 - 40;
+        Tileset *tileset = (i % 3) ? first : second;
+        Tile *tile = (i % 5) ? tileset->tileAt(i % 2) : 0;
+        source.setTile(x, y, tile);
+        blitted.setTile(y, x, tile);
+        expected.setTile(y, x, tile);
+    }
+
+    const QRect area(-80, -80, 260, 260);
+    QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+
+    // Chunk aligned, unaligned, negative and narrow rectangles
+    const QRect rects[] = {
+        QRect(0, 0, 64, 64), QRect(3, -7, 50, 41),
+        QRect(-45, -40, 100, 90), QRect(31, 31, 2, 70)
+    };
+    const QPoint sourcePositions[] = {
+        QPoint(32, -32), QPoint(-20, 11), QPoint(-13, -64), QPoint(1, 1)
+    };
+
+    for (int i = 0; i < 4; ++i) {
+        blitted.copyRect(rects[i], &source, sourcePositions[i]);
+        copyCells(&expected, rects[i], &source, sourcePositions[i], false);
+        QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+
+        const QPoint mergePos = sourcePositions[i] + QPoint(7, -5);
+        blitted.mergeRect(rects[i], &source, mergePos);
+        copyCells(&expected, rects[i], &source, mergePos, true);
+        QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+    }
+
+    // A stamp with a hole in it, starting somewhere inside the stamp
+    TileLayer stamp(QLatin1String("Stamp"), 0, 0, QRect(0, 0, 3, 2));
+    stamp.setTile(0, 0, second->tileAt(0));
+    stamp.setTile(2, 0, first->tileAt(1));
+    stamp.setTile(0, 1, first->tileAt(0));
+    stamp.setTile(1, 1, second->tileAt(1));
+    const QRect fillRect(-20, -20, 70, 45);
+    const QPoint origin(-1, 4);
+    blitted.fillStamp(fillRect, &stamp, origin);
+    for (int y = fillRect.top(); y <= fillRect.bottom(); ++y) {
+        for (int x = fillRect.left(); x <= fillRect.right(); ++x) {
+            const int stampX = ((x - origin.x()) % 3 + 3) % 3;
+            const int stampY = ((y - origin.y()) % 2 + 2) % 2;
+            if (Tile *tile = stamp.tileAt(stampX, stampY))
+                expected.setTile(x, y, tile);
+        }
+    }
+    QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+
+    const QRect clearRect(10, -30, 40, 100);
+    blitted.clearRect(clearRect);
+    for (int y = clearRect.top(); y <= clearRect.bottom(); ++y)
+        for (int x = clearRect.left(); x <= clearRect.right(); ++x)
+            expected.setTile(x, y, 0);
+    QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+
+    // Blits within the same layer, with overlapping rectangles
+    TileLayer *before = static_cast<TileLayer*>(expected.clone());
+    blitted.copyRect(QRect(0, 0, 70, 60), &blitted, QPoint(5, 3));
+    copyCells(&expected, QRect(0, 0, 70, 60), before, QPoint(5, 3), false);
+    QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+    delete before;
+
+    before = static_cast<TileLayer*>(expected.clone());
+    blitted.mergeRect(QRect(-27, -13, 70, 60), &blitted, QPoint(-30, -16));
+    copyCells(&expected, QRect(-27, -13, 70, 60), before, QPoint(-30, -16),
+              true);
+    QCOMPARE(tilesIn(&blitted, area), tilesIn(&expected, area));
+    delete before;
+
+    QCOMPARE(blitted.bounds(), expected.bounds());
+    QCOMPARE(blitted.region(), expected.region());
+    QCOMPARE(blitted.usedTilesets(), expected.usedTilesets());
+    QCOMPARE(blitted.tilesetReferences(first),
+             expected.tilesetReferences(first));
+    QCOMPARE(blitted.tilesetReferences(second),
+             expected.tilesetReferences(second));
+
+    delete first;
+    delete second;
+}
+
+QTEST_MAIN(test_TileLayer)
+#include "test_tilelayer.moc"